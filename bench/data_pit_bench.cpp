@@ -0,0 +1,218 @@
+/*
+ *  data_pit_bench.cpp
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "data_pit.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The number of data produced to each queue in an iteration
+const int messages = 20000;
+// The size of the queues
+const size_t queue_size = 1024;
+
+// A message of a given size, stamped with the time it is produced at
+template<size_t Size>
+struct message
+{
+    static_assert(Size >= sizeof(int64_t), "a message holds at least its stamp");
+
+    int64_t stamp = 0;
+    std::array<char, Size - sizeof(int64_t)> payload{};
+};
+
+// The current time in nanoseconds
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The arguments of a benchmark, which describe how the queues are produced and consumed
+struct topology
+{
+    // The number of queues, each with its own producers and consumers
+    int queues;
+    // The number of producers of each queue
+    int producers;
+    // The number of consumers of each queue
+    int consumers;
+    // Whether the consumers of a queue share their data as a group, or each of them receives all the data
+    bool group;
+    // Whether the consumers block until data are available, or poll the queue
+    bool blocking;
+
+    explicit topology(const benchmark::State& state)
+        : queues(static_cast<int>(state.range(0))), producers(static_cast<int>(state.range(1))),
+          consumers(static_cast<int>(state.range(2))), group(state.range(3) != 0), blocking(state.range(4) != 0) {}
+};
+
+// Produce and consume the data of an iteration, returning the latencies of the data consumed
+template<typename Message>
+std::vector<int64_t> run_iteration(const topology& t)
+{
+    // A queue of single producer is lock-free, and every queue makes its producers wait while it is full
+    data_pit dp;
+    auto mode = t.producers == 1 ? data_pit_queue_mode::single_producer : data_pit_queue_mode::multi_producer;
+    std::vector<unsigned int> consumer_ids;
+    for(auto queue = 0; queue < t.queues; ++queue)
+    {
+        dp.create_queue(queue, mode, queue_size);
+        dp.set_overflow_policy(queue, data_pit_overflow_policy::block);
+        for(auto i = 0; i < t.consumers; ++i)
+        {
+            consumer_ids.push_back(t.group ? dp.register_consumer(queue, 1) : dp.register_consumer(queue));
+        }
+    }
+
+    // The data each consumer waits for: all the data of its queue, or the data left to its group
+    std::vector<std::atomic<int>> group_consumed(t.queues);
+    std::vector<int64_t> latencies;
+    std::mutex latencies_mutex;
+
+    std::list<std::thread> threads;
+    for(auto queue = 0; queue < t.queues; ++queue)
+    {
+        for(auto i = 0; i < t.producers; ++i)
+        {
+            // The data of a queue are split among its producers
+            auto count = messages / t.producers + (i < messages % t.producers ? 1 : 0);
+            threads.emplace_back([&dp, queue, count]()
+            {
+                auto producer = dp.producer_handle(queue);
+                Message data;
+                for(auto n = 0; n < count;)
+                {
+                    data.stamp = now_ns();
+                    if(producer.produce(data) == data_pit_result::success) ++n;
+                }
+            });
+        }
+        for(auto i = 0; i < t.consumers; ++i)
+        {
+            auto consumer_id = consumer_ids[queue * t.consumers + i];
+            threads.emplace_back([&, queue, consumer_id]()
+            {
+                auto consumer = dp.consumer_handle(consumer_id).value();
+                std::vector<int64_t> local;
+                local.reserve(messages);
+                auto done = [&]()
+                {
+                    return t.group ? group_consumed[queue].load(std::memory_order_relaxed) >= messages
+                                   : static_cast<int>(local.size()) >= messages;
+                };
+
+                // A consumer of a group waits with a timeout, since the others may consume the last data
+                while(!done())
+                {
+                    auto data = t.blocking ? consumer.consume<Message>(true, 10) : consumer.consume<Message>();
+                    if(!data.has_value()) continue;
+                    local.push_back(now_ns() - data->stamp);
+                    if(t.group) group_consumed[queue].fetch_add(1, std::memory_order_relaxed);
+                }
+
+                std::lock_guard lock(latencies_mutex);
+                latencies.insert(latencies.end(), local.begin(), local.end());
+            });
+        }
+    }
+    for(auto &thread : threads)
+    {
+        thread.join();
+    }
+    return latencies;
+}
+
+// The latency below which a fraction of the data are consumed, in nanoseconds
+double percentile(std::vector<int64_t>& latencies, double fraction)
+{
+    if(latencies.empty()) return 0;
+    auto position = latencies.begin() + static_cast<std::ptrdiff_t>(fraction * static_cast<double>(latencies.size() - 1));
+    std::nth_element(latencies.begin(), position, latencies.end());
+    return static_cast<double>(*position);
+}
+
+// Measure the throughput of a topology, and the latency from producing a data to consuming it
+template<typename Message>
+void bm_data_pit(benchmark::State& state)
+{
+    topology t(state);
+    std::vector<int64_t> latencies;
+    for(auto _ : state)
+    {
+        auto iteration = run_iteration<Message>(t);
+        latencies.insert(latencies.end(), iteration.begin(), iteration.end());
+    }
+
+    // The data consumed by all the consumers, each of them counting once per consumer unless they share a group
+    state.SetItemsProcessed(static_cast<int64_t>(latencies.size()));
+    state.SetBytesProcessed(static_cast<int64_t>(latencies.size() * sizeof(Message)));
+    state.counters["p50_ns"] = percentile(latencies, 0.5);
+    state.counters["p99_ns"] = percentile(latencies, 0.99);
+    state.counters["p999_ns"] = percentile(latencies, 0.999);
+}
+
+// Register a benchmark of a topology
+template<typename Message>
+void register_topology(const char* name, int queues, int producers, int consumers, bool group, bool blocking)
+{
+    benchmark::RegisterBenchmark(name, bm_data_pit<Message>)
+            ->Args({queues, producers, consumers, group, blocking})
+            ->ArgNames({"queues", "producers", "consumers", "group", "blocking"})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+}
+
+int main(int argc, char** argv)
+{
+    // The topologies, with messages holding only their stamp
+    register_topology<message<8>>("one_to_one", 1, 1, 1, false, true);
+    register_topology<message<8>>("one_to_one", 1, 1, 1, false, false);
+    register_topology<message<8>>("broadcast", 1, 1, 4, false, true);
+    register_topology<message<8>>("broadcast", 1, 1, 4, false, false);
+    register_topology<message<8>>("many_to_one", 1, 4, 1, false, true);
+    register_topology<message<8>>("many_to_one", 1, 4, 1, false, false);
+    register_topology<message<8>>("many_to_many", 1, 4, 4, true, true);
+    register_topology<message<8>>("many_to_many", 1, 4, 4, true, false);
+    register_topology<message<8>>("multiple_queues", 4, 1, 1, false, true);
+    register_topology<message<8>>("multiple_queues", 4, 1, 1, false, false);
+
+    // The payload sizes, from one to one
+    register_topology<message<64>>("payload_64", 1, 1, 1, false, true);
+    register_topology<message<512>>("payload_512", 1, 1, 1, false, true);
+    register_topology<message<4096>>("payload_4096", 1, 1, 1, false, true);
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ *  false_sharing.cpp
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "data_pit.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <thread>
+
+// The number of operations made by each thread
+const uint64_t operations = 10000000;
+// The number of data produced in the consumer benchmarks
+const int messages = 1000000;
+
+// Two counters written by different threads, sharing a cache line as the fields of a tuple do
+struct packed_counters
+{
+    std::atomic<uint64_t> producer{0};
+    std::atomic<uint64_t> consumer{0};
+};
+
+// The same counters on cache lines of their own, as the fields of the queues and consumers are laid out
+struct padded_counters
+{
+    alignas(DATA_PIT_CACHE_LINE_SIZE) std::atomic<uint64_t> producer{0};
+    alignas(DATA_PIT_CACHE_LINE_SIZE) std::atomic<uint64_t> consumer{0};
+};
+
+// Run a function in a number of threads, returning the elapsed time in milliseconds
+template<typename Function>
+double run_threads(int threads_count, Function&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::list<std::thread> threads;
+    for(auto i = 0; i < threads_count; ++i)
+    {
+        threads.emplace_back(function, i);
+    }
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Increment two counters from two threads
+template<typename Counters>
+double counters_benchmark()
+{
+    Counters counters;
+    return run_threads(2, [&counters](int thread)
+    {
+        auto& counter = thread == 0 ? counters.producer : counters.consumer;
+        for(uint64_t i = 0; i < operations; ++i)
+        {
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+}
+
+// Drain a single_producer queue with a number of consumers, each on its own thread, while it is produced
+double consumers_benchmark(int consumers_count)
+{
+    data_pit dp;
+    dp.create_queue(0, data_pit_queue_mode::single_producer, 1024);
+    std::vector<data_pit_consumer_handle> consumers;
+    for(auto i = 0; i < consumers_count; ++i)
+    {
+        consumers.push_back(dp.consumer_handle(dp.register_consumer(0)).value());
+    }
+
+    auto producer = dp.producer_handle(0);
+    return run_threads(consumers_count + 1, [&](int thread)
+    {
+        if(thread == consumers_count)
+        {
+            for(auto i = 0; i < messages;)
+            {
+                if(producer.produce(i) == data_pit_result::success) ++i;
+            }
+            return;
+        }
+
+        auto& consumer = consumers[thread];
+        for(auto i = 0; i < messages; ++i)
+        {
+            consumer.consume<int>(true, 10000);
+        }
+    });
+}
+
+int main()
+{
+    std::cout << "Counters written by two threads (" << operations << " increments each)" << std::endl;
+    std::cout << "  sharing a cache line:  " << counters_benchmark<packed_counters>() << " ms" << std::endl;
+    std::cout << "  on separate lines:     " << counters_benchmark<padded_counters>() << " ms" << std::endl;
+
+    std::cout << "Single_producer queue drained by N consumers (" << messages << " data)" << std::endl;
+    for(auto consumers_count : {1, 2, 4})
+    {
+        auto elapsed = consumers_benchmark(consumers_count);
+        std::cout << "  " << consumers_count << " consumers: " << elapsed << " ms, "
+                  << messages / elapsed * 1000.0 << " data/s" << std::endl;
+    }
+    return 0;
+}
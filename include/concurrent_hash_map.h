@@ -24,19 +24,34 @@
  */
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <unordered_map>
 #include <mutex>
 #include <shared_mutex>
+#include <optional>
+#include <vector>
+
+#include "cache_line.h"
 
 /**
  * @brief A concurrent hash map.
  *
+ * The entries are spread over a number of shards, each with its own lock on its own cache line, so that threads
+ * working on different keys do not contend on the same lock.
+ *
  * @tparam Key The key type.
  * @tparam Value The value type.
+ * @tparam Shards The number of shards.
+ * @tparam Map The map of each shard: std::unordered_map keeps the references to the values valid until they are
+ *             erased, while a flat_hash_map takes less memory and fewer cache misses but invalidates them on insertion.
  */
-template <typename Key, typename Value>
+template <typename Key, typename Value, size_t Shards = 1, typename Map = std::unordered_map<Key, Value>>
 class concurrent_hash_map
 {
+    static_assert(Shards > 0, "a concurrent_hash_map needs at least one shard");
+
 public:
     /**
      * @brief           Erase a key-value pair into the map.
@@ -46,8 +61,9 @@ public:
      */
     bool erase(const Key& key)
     {
-        std::unique_lock lock(mutex);
-        return map.erase(key);
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        return s.map.erase(key);
     }
 
     /**
@@ -58,9 +74,10 @@ public:
      */
     std::optional<Value> find(const Key& key) const
     {
-        std::shared_lock lock(mutex);
-        auto it = map.find(key);
-        if (it != map.end())
+        auto& s = shard(key);
+        std::shared_lock lock(s.mutex);
+        auto it = s.map.find(key);
+        if (it != s.map.end())
         {
             return it->second;
         }
@@ -78,8 +95,9 @@ public:
      */
     bool contains(const Key& key) const
     {
-        std::shared_lock lock(mutex);
-        return map.find(key) != map.end();
+        auto& s = shard(key);
+        std::shared_lock lock(s.mutex);
+        return s.map.find(key) != s.map.end();
     }
 
     /**
@@ -90,8 +108,48 @@ public:
      */
     Value& operator[](const Key& key)
     {
-        std::unique_lock lock(mutex);
-        return map[key];
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        return s.map[key];
+    }
+
+    /**
+     * @brief           Insert a key-value pair into the map, or assign the value if the key is already there.
+     *
+     * @param key       The key.
+     * @param value     The value.
+     * @return          True if the key-value pair was inserted, false if the value was assigned.
+     */
+    bool insert_or_assign(const Key& key, const Value& value)
+    {
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        auto [it, inserted] = s.map.try_emplace(key, value);
+        if (!inserted) it->second = value;
+        return inserted;
+    }
+
+    /**
+     * @brief           Return a reference to the value associated with the key, inserting it if the key is missing.
+     *
+     * @param key       The key.
+     * @param init      The function called on a new value before any other thread can access it.
+     * @return          The value.
+     */
+    template <typename Init>
+    Value& find_or_insert(const Key& key, Init&& init)
+    {
+        auto& s = shard(key);
+        {
+            std::shared_lock lock(s.mutex);
+            auto it = s.map.find(key);
+            if (it != s.map.end()) return it->second;
+        }
+
+        std::unique_lock lock(s.mutex);
+        auto [it, inserted] = s.map.try_emplace(key);
+        if (inserted) init(it->second);
+        return it->second;
     }
 
     /**
@@ -99,11 +157,34 @@ public:
      *
      * @param key       The key.
      * @return          The value.
+     * @note            The lock is released on return, so the reference is only safe while the key is not erased
+     *                  and, with a flat_hash_map, while no key is inserted. Use rcu_hash_map for stable references.
      */
     Value& at(const Key& key)
     {
-        std::shared_lock lock(mutex);
-        return map.at(key);
+        auto& s = shard(key);
+        std::shared_lock lock(s.mutex);
+        return s.map.at(key);
+    }
+
+    /**
+     * @brief           Return the keys currently stored in the map.
+     *
+     * @return          A copy of the keys.
+     */
+    std::vector<Key> keys() const
+    {
+        std::vector<Key> keys;
+        for (auto& s : shards)
+        {
+            std::shared_lock lock(s.mutex);
+            keys.reserve(keys.size() + s.map.size());
+            for (const auto& [key, value] : s.map)
+            {
+                keys.push_back(key);
+            }
+        }
+        return keys;
     }
 
     /**
@@ -111,13 +192,53 @@ public:
      */
     void clear()
     {
-        std::unique_lock lock(mutex);
-        map.clear();
+        for (auto& s : shards)
+        {
+            std::unique_lock lock(s.mutex);
+            s.map.clear();
+        }
     }
 
 private:
-    // The map
-    std::unordered_map<Key, Value> map;
-    // The mutex
-    mutable std::shared_mutex mutex;
-};
\ No newline at end of file
+    // A shard of the map, on its own cache line so that its lock does not share it with another shard
+    struct alignas(DATA_PIT_CACHE_LINE_SIZE) shard_t
+    {
+        // The map
+        Map map;
+        // The mutex
+        mutable std::shared_mutex mutex;
+    };
+
+    /**
+     * @brief           Return the shard holding a key.
+     *
+     * @param key       The key.
+     * @return          The shard.
+     */
+    shard_t& shard(const Key& key)
+    {
+        return shards[shard_index(key)];
+    }
+
+    const shard_t& shard(const Key& key) const
+    {
+        return shards[shard_index(key)];
+    }
+
+    static size_t shard_index(const Key& key)
+    {
+        if constexpr (Shards == 1)
+        {
+            return 0;
+        }
+        else
+        {
+            // Mix the hash, since the maps of the shards use its low bits as well
+            auto hash = static_cast<uint64_t>(std::hash<Key>{}(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>((hash >> 32) % Shards);
+        }
+    }
+
+    // The shards
+    std::array<shard_t, Shards> shards;
+};
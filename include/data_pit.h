@@ -24,22 +24,66 @@
  */
 #pragma once
 
+#include <array>
 #include <queue>
+#include <deque>
+#include <set>
+#include <thread>
+#include <vector>
 #include <mutex>
-#include <condition_variable>
 #include <optional>
-#include <any>
 #include <chrono>
-#include <typeindex>
-
+#include <typeinfo>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <coroutine>
+#include <functional>
+#include <unordered_set>
+
+#include "cache_line.h"
 #include "concurrent_hash_map.h"
+#include "event_fd.h"
+#include "flat_hash_map.h"
+#include "rcu_hash_map.h"
+#include "ring_buffer.h"
+#include "wait_sequence.h"
 
 #define DATA_PIT_VERSION_MAJOR 1
 #define DATA_PIT_VERSION_MINOR 0
 #define DATA_PIT_VERSION_PATCH 0
 #define DATA_PIT_VERSION (DATA_PIT_VERSION_MAJOR << 16 | DATA_PIT_VERSION_MINOR << 8 | DATA_PIT_VERSION_PATCH)
 
+// The default maximum size of the queues, which data_pit_queue_options override per queue or per data_pit
+#ifndef DATA_PIT_MAX_QUEUE_SIZE
 #define DATA_PIT_MAX_QUEUE_SIZE 1000
+#endif
+
+#ifndef DATA_PIT_SPIN_COUNT
+#define DATA_PIT_SPIN_COUNT 4000
+#endif
+
+#ifndef DATA_PIT_MAP_SHARDS
+#define DATA_PIT_MAP_SHARDS 16
+#endif
+
+// The number of data a thread of a parallel snapshot visits before taking more from the others
+#ifndef DATA_PIT_PARALLEL_GRAIN
+#define DATA_PIT_PARALLEL_GRAIN 4096
+#endif
+
+// Whether the queues record statistics, which get_queue_stats returns; the instrumentation is compiled out when 0
+#ifndef DATA_PIT_STATS
+#define DATA_PIT_STATS 0
+#endif
+
+#if DATA_PIT_STATS
+#include "data_pit_stats.h"
+#endif
 
 /**
  * @brief data_pit_result enum class
@@ -51,7 +95,109 @@ enum class data_pit_result : int
     timeout_expired     = -2,
     no_data_available   = -3,
     type_mismatch       = -4,
-    queue_is_full       = -5
+    queue_is_full       = -5,
+    queue_already_exists = -6,
+    data_dropped        = -7,
+    policy_not_supported = -8,
+    storage_error       = -9,
+    connection_error    = -10,
+    offset_out_of_range = -11
+};
+
+/**
+ * @brief data_pit_queue_mode enum class
+ *
+ * multi_producer queues accept data from any number of threads and serialize producers and consumers on a mutex.
+ * single_producer queues accept data from one thread at a time: producing and consuming are lock-free,
+ * and every consumer must consume from one thread at a time.
+ */
+enum class data_pit_queue_mode : int
+{
+    multi_producer      = 0,
+    single_producer     = 1
+};
+
+/**
+ * @brief data_pit_wait_policy enum class
+ *
+ * How a consumer waits for data in a blocking consume: block puts the thread to sleep at once, spin_then_block
+ * spins for DATA_PIT_SPIN_COUNT iterations before sleeping, and spin never sleeps, busying a core until data
+ * are available or the timeout expires.
+ */
+enum class data_pit_wait_policy : int
+{
+    block               = 0,
+    spin_then_block     = 1,
+    spin                = 2
+};
+
+/**
+ * @brief data_pit_overflow_policy enum class
+ *
+ * What producing does when a queue is full, once the slots of the data consumed by all the consumers are reclaimed:
+ * reject returns queue_is_full, block waits for the consumers to free enough slots until a timeout expires,
+ * overwrite_oldest drops the oldest data, drop_newest drops the data produced and returns data_dropped, and grow
+ * doubles the size of the queue. The queue counts the data dropped.
+ * Data viewed by a consumer are never dropped nor moved, in which case a full queue rejects the data, and
+ * single_producer queues only support reject, block and drop_newest, since their consumers read without locks.
+ */
+enum class data_pit_overflow_policy : int
+{
+    reject              = 0,
+    block               = 1,
+    overwrite_oldest    = 2,
+    drop_newest         = 3,
+    grow                = 4
+};
+
+/**
+ * @brief data_pit_queue_options struct
+ *
+ * The options a queue is created with. The slots of a queue are allocated once the type of its data is known, which
+ * create_queue<T> makes right away, so that large queues get their memory up front instead of on the hot path.
+ */
+struct data_pit_queue_options
+{
+    // The mode of the queue
+    data_pit_queue_mode mode = data_pit_queue_mode::multi_producer;
+    // The maximum number of data the queue holds
+    size_t capacity = DATA_PIT_MAX_QUEUE_SIZE;
+    // Whether the capacity is rounded up to a power of two, so that positions map to slots without a division
+    bool power_of_two = false;
+    // Whether the pages of the slots are touched when they are allocated, so that they never fault afterwards
+    bool prefault = false;
+    // The NUMA node the slots are preferably allocated on, or -1 for the policy of the allocating thread; only
+    // applied on Linux
+    int numa_node = -1;
+    // The memory resource the storage of the queue is allocated from, or nullptr for the resource of the data_pit
+    std::pmr::memory_resource* resource = nullptr;
+};
+
+template<typename T>
+class data_pit_channel;
+
+template<typename T>
+class data_pit_view;
+
+class data_pit_consumer_handle;
+
+class data_pit_producer_handle;
+
+template<typename T>
+class data_pit_snapshot;
+
+template<typename Consume, typename Executor>
+class data_pit_awaitable;
+
+/**
+ * @brief data_pit_inline_executor struct
+ *
+ * The default executor of asynchronous consumes, which resumes the coroutines right away on the thread that
+ * produces the data they wait for.
+ */
+struct data_pit_inline_executor
+{
+    void operator()(std::coroutine_handle<> handle) const { handle.resume(); }
 };
 
 /**
@@ -61,446 +207,3624 @@ class data_pit
 {
 public:
     /**
-     * @brief Constructor
+     * @brief               Constructor
+     * @param   resource    The memory resource the storage of the queues is allocated from, unless a queue is
+     *                      created with its own
+     * @note                The resource must be thread-safe, such as a std::pmr::synchronized_pool_resource
      */
-    data_pit() : m_next_consumer_id(1)
+    explicit data_pit(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_resource(resource), m_next_consumer_id(1)
     {
         m_queues_data.clear();
     }
 
     /**
-     * @brief               This function is used to produce data in the queue
-     * @tparam  T           The type of the data to be produced
+     * @brief               Constructor
+     * @param   defaults    The options of the queues used before being created, whose resource, if any, is the
+     *                      resource of the data_pit
+     */
+    explicit data_pit(const data_pit_queue_options& defaults)
+        : data_pit(defaults.resource != nullptr ? defaults.resource : std::pmr::get_default_resource())
+    {
+        m_queue_defaults = defaults;
+    }
+
+    /**
+     * @brief               This function is used to create a queue with a specific mode
      * @param   queue_id    The id of the queue
-     * @param   data        The data to be produced
+     * @param   mode        The mode of the queue
+     * @param   size        The maximum size of the queue
+     * @param   resource    The memory resource the storage of the queue is allocated from, or nullptr for the
+     *                      resource of the data_pit
      * @return              The result of the operation
+     * @note                Queues used before being created are multi_producer queues
+     * @note                The slots are allocated once the type of the queue is known, and the data whose type uses
+     *                      a polymorphic allocator, such as std::pmr::string, are allocated from the resource too
      */
-    template<typename T>
-    data_pit_result produce(int queue_id, const T& data)
+    data_pit_result create_queue(int queue_id, data_pit_queue_mode mode, size_t size = DATA_PIT_MAX_QUEUE_SIZE,
+                                 std::pmr::memory_resource* resource = nullptr)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock global_lock(m_mtx);
-
-        // Check if the queue with the given ID already exists and if the type of the data matches
-        if (m_queues_data.contains(queue_id))
-        {
-            if(!queue(queue_id).empty() && queue_type(queue_id) != std::type_index(typeid(T)).name())
-            {
-                // If the type of the data does not match, return a type mismatch error
-                return data_pit_result::type_mismatch;
-            }
-        }
-        else
-        {
-            // If the queue does not exist, initialize it
-            init_queue(queue_id);
-        }
-
-        // Lock the mutex for the specific queue
-        std::unique_lock lock(*queue_mutex(queue_id));
-
-        // Unlock the global mutex
-        global_lock.unlock();
-
-        // If the queue is full, return a queue is full error
-        if (queue(queue_id).size() >= queue_size(queue_id)) return data_pit_result::queue_is_full;
-
-        // Set the type of the data for the queue
-        queue_type(queue_id) = std::type_index(typeid(T)).name();
-
-        // Add the data to the queue
-        queue(queue_id).push_back(data);
-
-        // Notify all waiting threads that new data has been added
-        queue_cv(queue_id).notify_all();
-
-        // Return success
-        return data_pit_result::success;
+        data_pit_queue_options options;
+        options.mode = mode;
+        options.capacity = size;
+        options.resource = resource;
+        return create_queue(queue_id, options);
     }
 
     /**
-     * @brief               This function is used to consume data from the queue
-     * @tparam  T           The type of data to be consumed
-     * @param   consumer_id The ID of the consumer
-     * @param   blocking    If true, the function will wait until there are data available
-     * @param   timeout_ms  The maximum waiting time in milliseconds
-     * @return              The consumed data, or std::nullopt if no data are available
+     * @brief               This function is used to create a queue with specific options
+     * @param   queue_id    The id of the queue
+     * @param   options     The options of the queue
+     * @return              The result of the operation
+     * @note                The slots are allocated, placed and prefaulted once the type of the queue is known:
+     *                      create_queue<T> does it right away
      */
-    template<typename T>
-    std::optional<T> consume(unsigned int consumer_id, bool blocking = false,
-                             uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    data_pit_result create_queue(int queue_id, const data_pit_queue_options& options)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
-        // Check if the consumer_id exists
-        if (!m_consumers_data.contains(consumer_id))
-        {
-            lock.unlock();
-            set_last_error(consumer_id, data_pit_result::consumer_not_found);
-            return std::nullopt;
-        }
-
-        auto queue_id = std::get<0>(m_consumers_data.at(consumer_id));
-
-        // Check if the queue_id exists
-        if (m_queues_data.contains(queue_id))
-        {
-            // TODO FIXME - This is a temporary fix to avoid empty strings
-            while (queue_type(queue_id).empty());
-
-            if(queue_type(queue_id) != std::type_index(typeid(T)).name())
-            {
-                lock.unlock();
-                set_last_error(consumer_id, data_pit_result::type_mismatch);
-                return std::nullopt;
-            }
-        }
-        else
+        // The mode of a queue cannot change once the queue exists
+        bool created = false;
+        m_queues_data.find_or_insert(queue_id, [&](data_t& q_data)
         {
-            init_queue(queue_id);
-            queue_type(queue_id) = std::type_index(typeid(T)).name();
-        }
-
-        // Lock the mutex for the specific queue
-        std::unique_lock queue_lock(*queue_mutex(queue_id));
-
-        // Unlock the global mutex
-        lock.unlock();
-
-        // Get the index of the consumer
-        auto& index = consumer_index(consumer_id);
-
-        // If blocking is true, wait until there are data available
-        if (blocking)
-        {
-            if(queue_cv(queue_id).
-                wait_for(queue_lock, std::chrono::milliseconds(timeout_ms),
-                         [&]()
-                         {
-                             return index < queue(queue_id).size();
-                         }) == false)
-            {
-                // Unlock the mutex before returning
-                queue_lock.unlock();
-
-                // Timeout expired
-                set_last_error(consumer_id, data_pit_result::timeout_expired);
-                return std::nullopt;
-            }
-        }
-
-        // If there are no data available, return std::nullopt
-        if (index >= queue(queue_id).size())
-        {
-            queue_lock.unlock();
-            set_last_error(consumer_id, data_pit_result::no_data_available);
-            return std::nullopt;
-        }
-
-        // Fetch the data from the queue
-        T data = std::any_cast<T>(queue(queue_id).at(index));
-
-        // Increment the consumer's index
-        index++;
+            init_queue(q_data, options);
+            created = true;
+        });
 
-        // Return the data
-        return data;
+        return created ? data_pit_result::success : data_pit_result::queue_already_exists;
     }
 
     /**
-     * @brief               This function is used to register a consumer to a queue
+     * @brief               This function is used to create a queue of data of a specific type, allocating its
+     *                      slots right away
+     * @tparam  T           The type of the data of the queue
      * @param   queue_id    The id of the queue
-     * @return              The id of the registered consumer or 0 if the maximum number of consumers has been reached
+     * @param   options     The options of the queue
+     * @return              The result of the operation
+     * @note                The type of the queue cannot change, so its slots are never allocated again unless its
+     *                      size is set or its overflow policy grows it
      */
-    unsigned int register_consumer(int queue_id)
+    template<typename T>
+    data_pit_result create_queue(int queue_id, const data_pit_queue_options& options = {})
     {
-        // Register a new consumer and get its ID
-        unsigned int consumer_id = register_id();
-
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
-        // If the consumer_id is 0, it means that the maximum number of consumers has been reached
-        if(consumer_id == 0) return 0;
-
-        // Add the consumer to the map of consumers
-        // The consumer is associated with the queue_id, its index in the queue (initially 0), and its last error (initially success)
-        m_consumers_data[consumer_id] = std::make_tuple(queue_id, 0, data_pit_result::success);
+        bool created = false;
+        m_queues_data.find_or_insert(queue_id, [&](data_t& q_data)
+        {
+            init_queue(q_data, options);
+            bind_queue_type<T>(q_data, true);
+            queue_pinned(q_data) = true;
+            created = true;
+        });
 
-        // Return the consumer_id
-        return consumer_id;
+        return created ? data_pit_result::success : data_pit_result::queue_already_exists;
     }
 
     /**
-     * @brief               This function is used to unregister a consumer from a queue
-     * @param   consumer_id The id of the consumer to be unregistered
+     * @brief               This function is used to get the maximum size of a queue
+     * @param   queue_id    The id of the queue
+     * @return              The maximum size of the queue, or std::nullopt if the queue does not exist
      */
-    void unregister_consumer(unsigned int consumer_id)
+    std::optional<size_t> get_queue_capacity(int queue_id)
     {
-        // Release the consumer_id for future use
-        unregister_id(consumer_id);
-
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
+        // Check if the queue exists
+        if (!m_queues_data.contains(queue_id)) return std::nullopt;
+        auto& q_data = queue_data(queue_id);
 
-        // Remove the consumer from the map of consumers
-        m_consumers_data.erase(consumer_id);
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        return queue(q_data).capacity();
     }
 
     /**
-     * @brief               This function is used to clear a specific queue
-     * @param   queue_id    The id of the queue to be cleared
+     * @brief               This function is used to create a queue whose data are kept in a memory-mapped file,
+     *                      so that they survive the process
+     * @tparam  T           The type of the data of the queue, which must be trivially copyable
+     * @param   queue_id    The id of the queue
+     * @param   path        The path of the file, which is created if it holds no queue yet
+     * @param   mode        The mode of the queue
+     * @param   size        The maximum size of a new queue; a queue found in the file keeps its own
+     * @return              The result of the operation: type_mismatch if the file holds data of another size,
+     *                      storage_error if it cannot be mapped
+     * @note                The queue resumes where the file was left, and its persistent consumers where they were
+     *                      left: see register_persistent_consumer. Its size cannot change.
      */
-    void clear_queue(int queue_id)
+    template<typename T>
+    data_pit_result create_persistent_queue(int queue_id, const std::string& path,
+                                            data_pit_queue_mode mode = data_pit_queue_mode::multi_producer,
+                                            size_t size = DATA_PIT_MAX_QUEUE_SIZE)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
+        static_assert(std::is_trivially_copyable_v<T>, "the data of a persistent queue must be trivially copyable");
+        if (m_queues_data.contains(queue_id)) return data_pit_result::queue_already_exists;
 
-        // Clear the specific queue
-        queue(queue_id).clear();
+        // Map the file before creating the queue, so that a queue is never created without its storage
+        return create_mapped_queue<T>(queue_id, mapped_ring::open(path, size, sizeof(T), alignof(T)), mode);
     }
 
     /**
-     * @brief This function is used to clear all queues
+     * @brief               This function is used to create a queue in a shared memory object, which the data_pits
+     *                      of other processes on the host attach to by its name
+     * @tparam  T           The type of the data of the queue, which must be trivially copyable
+     * @param   queue_id    The id of the queue, which may differ in every process
+     * @param   name        The name of the shared memory object, starting with a slash, which is created if it
+     *                      does not exist yet
+     * @param   mode        The mode of the queue in this process
+     * @param   size        The maximum size of a new queue; a queue found in the object keeps its own
+     * @return              The result of the operation: type_mismatch if the object holds data of another size,
+     *                      storage_error if it cannot be mapped
+     * @note                Only one process produces, clears and resizes the queue, and only the consumers of that
+     *                      process can view data. The consumers of every process retain their data, and blocking
+     *                      consumers and producers are woken up across processes on Linux; polling, coroutines and
+     *                      file descriptors only see the data produced in their own process.
      */
-    void clear_all_queues()
+    template<typename T>
+    data_pit_result attach_shared_queue(int queue_id, const std::string& name,
+                                        data_pit_queue_mode mode = data_pit_queue_mode::single_producer,
+                                        size_t size = DATA_PIT_MAX_QUEUE_SIZE)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
+        static_assert(std::is_trivially_copyable_v<T>, "the data of a shared queue must be trivially copyable");
+        if (m_queues_data.contains(queue_id)) return data_pit_result::queue_already_exists;
 
-        // Clear all queues
-        m_queues_data.clear();
+        // Map the object before creating the queue, so that a queue is never created without its storage
+        return create_mapped_queue<T>(queue_id, mapped_ring::open_shared(name, size, sizeof(T), alignof(T)), mode);
     }
 
     /**
-     * @brief               This function is used to reset a consumer's position in the queue
-     * @param   consumer_id The id of the consumer to be reset
+     * @brief               This function is used to remove a shared memory object, so that the queue it holds
+     *                      is created again by the next process attaching to it
+     * @param   name        The name of the shared memory object
+     * @return              True if the object was removed
+     * @note                The processes attached to the queue keep using it
      */
-    void reset_consumer(unsigned int consumer_id)
+    static bool remove_shared_queue(const std::string& name)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
-        // Check if consumer_id exists
-        if (!m_consumers_data.find(consumer_id).has_value()) return;
-
-        // Reset the consumer's index in the queue to 0
-        std::get<1>(m_consumers_data[consumer_id]) = 0;
+        return mapped_ring::remove_shared(name);
     }
 
     /**
-     * @brief               This function is used to set the maximum size of a specific queue
+     * @brief               This function is used to write the data of a persistent queue to its file
      * @param   queue_id    The id of the queue
-     * @param   size        The maximum size of the queue
+     * @return              The result of the operation, storage_error if the data cannot be written
+     * @note                The data are written by the operating system in the background anyway, so they survive
+     *                      the process without this function; it is needed for them to survive the operating system
      */
-    void set_queue_size(int queue_id, size_t size)
+    data_pit_result sync_queue(int queue_id)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
         // Check if the queue exists
-        if(!m_queues_data.contains(queue_id))
-        {
-            // Initialize the queue if it doesn't exist
-            init_queue(queue_id);
-        }
-
-        // Set the maximum size of the queue
-        queue_size(queue_id) = size;
+        if (!m_queues_data.contains(queue_id)) return data_pit_result::storage_error;
+        auto mapping = queue_data(queue_id).mapping;
+        return mapping != nullptr && mapping->sync() ? data_pit_result::success : data_pit_result::storage_error;
     }
 
     /**
-     * @brief               This function is used to get the last error of a specific consumer
-     * @param   consumer_id The id of the consumer
-     * @return              The last error of the consumer
+     * @brief               This function is used to produce data in the queue
+     * @tparam  T           The type of the data to be produced
+     * @param   queue_id    The id of the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
      */
-    data_pit_result get_last_error(unsigned int consumer_id)
+    template<typename T>
+    data_pit_result produce(int queue_id, const T& data)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
-        // Check if consumer_id exists
-        if (!m_consumers_data.find(consumer_id).has_value())
+        // Add the data to the queue, initializing it if it does not exist
+        return produce_data<T>(queue_data(queue_id), 1, true, [&](ring_buffer<T>& ring)
         {
-            // If the consumer_id does not exist, return a consumer not found error
-            return data_pit_result::consumer_not_found;
-        }
-
-        // Return the last error of the consumer
-        return data_pit_error(consumer_id);
+            ring.emplace_back(data);
+        });
     }
 
-private:
-
     /**
-     * @brief               This function is used to set the last error of a specific consumer
-     * @param   consumer_id The id of the consumer
-     * @param   error       The error to be set
+     * @brief               This function is used to produce data in the queue, moving it into the queue
+     * @tparam  T           The type of the data to be produced
+     * @param   queue_id    The id of the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                The data is left untouched if it is not produced
      */
-    void set_last_error(unsigned int consumer_id, data_pit_result error)
+    template<typename T> requires std::is_same_v<T, std::remove_cvref_t<T>>
+    data_pit_result produce(int queue_id, T&& data)
     {
-        // Lock the mutex to ensure thread safety
-        std::unique_lock lock(m_mtx);
-
-        // Check if consumer_id exists
-        if (!m_consumers_data.find(consumer_id).has_value()) return;
-
-        // Set the last error of the consumer
-        data_pit_error(consumer_id) = error;
+        // Add the data to the queue, initializing it if it does not exist
+        return produce_data<T>(queue_data(queue_id), 1, true, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::move(data));
+        });
     }
 
     /**
-     * @brief               This function is used to initialize a queue
+     * @brief               This function is used to produce data in the queue, constructing it in place
+     * @tparam  T           The type of the data to be produced
      * @param   queue_id    The id of the queue
+     * @param   args        The arguments forwarded to the constructor of the data
+     * @return              The result of the operation
      */
-    inline void init_queue(int queue_id)
+    template<typename T, typename... Args>
+    data_pit_result emplace(int queue_id, Args&&... args)
     {
-        // Clear the vector and set the maximum size of the queue
-        auto&[vector, size] = std::get<0>(m_queues_data[queue_id]);
-        vector.clear();
-        size = DATA_PIT_MAX_QUEUE_SIZE;
-
-        // Create a new mutex for the queue
-        std::get<2>(m_queues_data[queue_id]) = std::make_unique<std::mutex>();
+        // Add the data to the queue, initializing it if it does not exist
+        return produce_data<T>(queue_data(queue_id), 1, true, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::forward<Args>(args)...);
+        });
     }
 
     /**
-     * @brief               This function is used to get the queue with a specific id
+     * @brief               This function is used to produce a batch of data in the queue
+     * @tparam  T           The type of the data to be produced
      * @param   queue_id    The id of the queue
-     * @return              The queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                Either the whole batch is produced or none of it, so a batch larger than the maximum
+     *                      size of the queue is never produced
      */
-    inline std::vector<std::any>& queue(int queue_id)
+    template<typename T>
+    data_pit_result produce_bulk(int queue_id, std::span<const T> data)
     {
-        return std::get<0>(m_queues_data.at(queue_id)).first;
+        // Add the data to the queue under a single critical section, initializing it if it does not exist
+        return produce_data<T>(queue_data(queue_id), data.size(), true, [&](ring_buffer<T>& ring)
+        {
+            ring.append(data.begin(), data.end());
+        });
     }
 
     /**
-     * @brief               This function is used to get the maximum size of a specific queue
-     * @param   queue_id    The id of the queue
-     * @return              The maximum size of the queue
+     * @brief               This function is used to consume data from the queue
+     * @tparam  T           The type of data to be consumed
+     * @param   consumer_id The ID of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
      */
-    inline size_t& queue_size(int queue_id)
+    template<typename T>
+    std::optional<T> consume(unsigned int consumer_id, bool blocking = false,
+                             uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
     {
-        return std::get<0>( m_queues_data.at(queue_id)).second;
+        // Check if the consumer_id exists, otherwise there is no consumer to store the error for
+        // The consumer stays alive while it is used, even if it is unregistered meanwhile
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        consume_data<T>(q_data, *consumer.value(), blocking, timeout_ms, true, 1,
+                        [&](ring_buffer<T>& ring, index_t position, size_t)
+                        {
+                            data.emplace(ring.at(position));
+                        });
+        return data;
     }
 
     /**
-     * @brief               This function is used to get the type of the data in a specific queue
-     * @param   queue_id    The id of the queue
-     * @return              The type of the data in the queue
+     * @brief               This function is used to consume data from the queue, moving it out of the queue
+     *                      if no other consumer needs it
+     * @tparam  T           The type of data to be consumed
+     * @param   consumer_id The ID of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     * @note                Data moved out are discarded, so consumers registered or reset later do not see them; the
+     *                      data within the retention of the queue, if set, are copied instead
      */
-    inline std::string& queue_type(int queue_id)
+    template<typename T>
+    std::optional<T> consume_move(unsigned int consumer_id, bool blocking = false,
+                                  uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
     {
-        return std::get<1>(m_queues_data.at(queue_id));
+        // Check if the consumer_id exists, otherwise there is no consumer to store the error for
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        consume_data<T>(q_data, *consumer.value(), blocking, timeout_ms, true, 1,
+                        move_reader<T>(q_data, *consumer.value(), data));
+        return data;
     }
 
     /**
-     * @brief               This function is used to get the mutex for a specific queue
-     * @param   queue_id    The id of the queue
-     * @return              The mutex for the queue
+     * @brief               This function is used to consume data from the queue without copying it
+     * @tparam  T           The type of data to be consumed
+     * @param   consumer_id The ID of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              A view of the consumed data, or std::nullopt if no data are available
+     * @note                The view is valid until it is released, or the consumer consumes again, is unregistered,
+     *                      or the size of the queue is set
      */
-    inline std::mutex* queue_mutex(int queue_id)
+    template<typename T>
+    std::optional<data_pit_view<T>> consume_view(unsigned int consumer_id, bool blocking = false,
+                                                 uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
     {
-        return std::get<2>(m_queues_data.at(queue_id)).get();
+        // Check if the consumer_id exists, otherwise there is no consumer to store the error for
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
+
+        // Fetch the data from the queue, holding its slot
+        std::optional<data_pit_view<T>> view;
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        consume_data<T>(q_data, *consumer.value(), blocking, timeout_ms, true, 1,
+                        view_reader<T>(consumer.value(), view));
+        return view;
     }
 
     /**
-     * @brief               This function is used to get the condition variable for a specific queue
-     * @param   queue_id    The id of the queue
-     * @return              The condition variable for the queue
+     * @brief               This function is used to consume a batch of data from the queue
+     * @tparam  T           The type of data to be consumed
+     * @param   consumer_id The ID of the consumer
+     * @param   out         The destination of the consumed data
+     * @param   max_n       The maximum number of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The number of data consumed, 0 if no data are available
      */
-    inline std::condition_variable& queue_cv(int queue_id)
+    template<typename T, typename OutputIt>
+    size_t consume_bulk(unsigned int consumer_id, OutputIt out, size_t max_n, bool blocking = false,
+                        uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
     {
-        return std::get<3>(m_queues_data.at(queue_id));
+        // Check if the consumer_id exists, otherwise there is no consumer to store the error for
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value() || max_n == 0) return 0;
+
+        // Fetch the data from the queue under a single critical section
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        return consume_data<T>(q_data, *consumer.value(), blocking, timeout_ms, true, max_n,
+                               [&](ring_buffer<T>& ring, index_t position, size_t count)
+                               {
+                                   out = ring.copy(position, count, out);
+                               });
     }
 
     /**
-     * @brief               This function is used to get the index of a specific consumer
-     * @param   consumer_id The id of the consumer
-     * @return              The index of the consumer
+     * @brief               This function is used to wait until some consumers have data available
+     * @param   consumer_ids The IDs of the consumers, which may consume from different queues
+     * @param   ready       The destination of the IDs of the consumers with data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds, 0 to only check the consumers
+     * @return              The number of consumers with data available, 0 if the timeout expired
+     * @note                The polling thread sleeps on a single sequence, which the producers advance while any
+     *                      thread polls; unknown consumer IDs are ignored
      */
-    inline size_t& consumer_index(unsigned int consumer_id)
+    template<typename OutputIt>
+    size_t poll(std::span<const unsigned int> consumer_ids, OutputIt ready,
+                uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
     {
-        return std::get<1>(m_consumers_data.at(consumer_id));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+        // Count the thread as polling before checking the consumers, so that data produced meanwhile are notified
+        m_pollers.fetch_add(1, std::memory_order_seq_cst);
+        size_t count = 0;
+        bool expired = false;
+        while (true)
+        {
+            // Read the sequence before checking the consumers, so that no notification is missed
+            auto sequence = m_poll_signal.load();
+            for (auto consumer_id : consumer_ids)
+            {
+                auto consumer = m_consumers_data.find(consumer_id);
+                if (!consumer.has_value()) continue;
+
+                if (has_data(queue_data(consumer_queue(*consumer.value())), *consumer.value()))
+                {
+                    *ready++ = consumer_id;
+                    ++count;
+                }
+            }
+            if (count > 0 || expired || timeout_ms == 0) break;
+            expired = !m_poll_signal.wait_until(sequence, deadline);
+        }
+        m_pollers.fetch_sub(1, std::memory_order_relaxed);
+        return count;
     }
 
     /**
-     * @brief               This function is used to get the last error of a specific consumer
-     * @param   consumer_id The id of the consumer
-     * @return              The last error of the consumer
+     * @brief               This function is used to get a file descriptor which is readable while a consumer has
+     *                      data available, to be waited on by an event loop
+     * @param   consumer_id The ID of the consumer
+     * @return              The file descriptor, or std::nullopt if the consumer does not exist or no descriptor can
+     *                      be opened on this platform
+     * @note                The descriptor stays readable until rearm_consumer_fd is called, which must be called
+     *                      before consuming. It is closed once the consumer is unregistered and no handle refers to it.
      */
-    inline data_pit_result& data_pit_error(unsigned int consumer_id)
+    std::optional<int> consumer_fd(unsigned int consumer_id)
     {
-        return std::get<2>(m_consumers_data.at(consumer_id));
-    }
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
 
+        auto& c_data = *consumer.value();
+        auto& q_data = queue_data(consumer_queue(c_data));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if (!consumer_registered(c_data).load(std::memory_order_acquire)) return std::nullopt;
 
-    /**
-     * @brief This function is used to register a new consumer ID
-     * @return The registered consumer ID or 0 if the maximum number of consumers has been reached
+        // Count the descriptor before checking for data, so that the producers signal it if there are none
+        auto& readiness = consumer_readiness(c_data);
+        if (!readiness.is_open())
+        {
+            if (readiness.open() == -1) return std::nullopt;
+            q_data.fd_watchers.fetch_add(1, std::memory_order_seq_cst);
+        }
+        if (data_available(q_data, c_data)) readiness.signal();
+        return readiness.open();
+    }
+
+    /**
+     * @brief               This function is used to make the file descriptor of a consumer unreadable until it has
+     *                      new data available
+     * @param   consumer_id The ID of the consumer
+     * @return              The result of the operation
+     * @note                The descriptor stays readable if the consumer still has data available
      */
-    unsigned int register_id()
+    data_pit_result rearm_consumer_fd(unsigned int consumer_id)
     {
-        // Lock the mutex to ensure thread safety
-        std::lock_guard lock(m_mtx);
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return data_pit_result::consumer_not_found;
+
+        // Clear the descriptor under the mutex, so that a producer cannot signal it between the clear and the check
+        auto& c_data = *consumer.value();
+        auto& q_data = queue_data(consumer_queue(c_data));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        auto& readiness = consumer_readiness(c_data);
+        readiness.clear();
+        if (data_available(q_data, c_data)) readiness.signal();
+        return data_pit_result::success;
+    }
 
-        unsigned int consumer_id;
+    /**
+     * @brief               This function is used to get the number of data a consumer has not consumed yet
+     * @param   consumer_id The ID of the consumer
+     * @return              The number of data available to the consumer, or std::nullopt if it does not exist
+     */
+    std::optional<uint64_t> get_consumer_lag(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
 
-        // Check if there are any released IDs available
-        if (!released_ids.empty())
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        auto head = queue(q_data).head();
+        return head - std::min(head, consumer_position(q_data, *consumer.value()));
+    }
+
+#if DATA_PIT_STATS
+    /**
+     * @brief               This function is used to get the statistics of a queue
+     * @param   queue_id    The id of the queue
+     * @return              The statistics of the queue, or std::nullopt if the queue does not exist
+     * @note                Only available when DATA_PIT_STATS is defined to 1
+     */
+    std::optional<data_pit_queue_stats> get_queue_stats(int queue_id)
+    {
+        // Check if the queue exists
+        if (!m_queues_data.contains(queue_id)) return std::nullopt;
+        auto& q_data = queue_data(queue_id);
+
+        data_pit_queue_stats stats;
+        q_data.stats.collect(stats);
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        stats.depth = queue(q_data).head() - oldest_data(q_data);
+        return stats;
+    }
+#endif
+
+    /**
+     * @brief               This function is used to consume data from the queue from a coroutine, which is
+     *                      suspended until the consumer has data available
+     * @tparam  T           The type of data to be consumed
+     * @tparam  Executor    The type of the executor
+     * @param   consumer_id The ID of the consumer
+     * @param   executor    The function called with the handle of the coroutine to resume it
+     * @return              An awaitable whose result is the consumed data, or std::nullopt if no data are available
+     * @note                The coroutine is resumed once data are produced for the consumer, or the consumer is reset
+     *                      or unregistered. Its data may still be claimed by another consumer of its group or cleared
+     *                      meanwhile, in which case the result is std::nullopt.
+     */
+    template<typename T, typename Executor = data_pit_inline_executor>
+    auto async_consume(unsigned int consumer_id, Executor executor = {})
+    {
+        return async_awaitable(consumer_id, std::move(executor), [this](data_t* q_data, consumer_data_t* c_data)
         {
-            // If there are, use the first one
-            consumer_id = released_ids.front();
-            released_ids.pop();
+            std::optional<T> data;
+            if (c_data == nullptr || !consumer_registered(*c_data).load(std::memory_order_acquire)) return data;
+
+            consume_data<T>(*q_data, *c_data, false, 0, true, 1, [&](ring_buffer<T>& ring, index_t position, size_t)
+            {
+                data.emplace(ring.at(position));
+            });
+            return data;
+        });
+    }
+
+    /**
+     * @brief               This function is used to consume a batch of data from the queue from a coroutine, which
+     *                      is suspended until the consumer has data available
+     * @tparam  T           The type of data to be consumed
+     * @tparam  Executor    The type of the executor
+     * @param   consumer_id The ID of the consumer
+     * @param   max_n       The maximum number of data to be consumed
+     * @param   executor    The function called with the handle of the coroutine to resume it
+     * @return              An awaitable whose result is the consumed data, empty if no data are available
+     * @note                The coroutine is resumed as in async_consume
+     */
+    template<typename T, typename Executor = data_pit_inline_executor>
+    auto async_consume_bulk(unsigned int consumer_id, size_t max_n, Executor executor = {})
+    {
+        return async_awaitable(consumer_id, std::move(executor),
+                               [this, max_n](data_t* q_data, consumer_data_t* c_data)
+        {
+            std::vector<T> data;
+            if (c_data == nullptr || !consumer_registered(*c_data).load(std::memory_order_acquire)) return data;
+
+            consume_data<T>(*q_data, *c_data, false, 0, true, max_n,
+                            [&](ring_buffer<T>& ring, index_t position, size_t count)
+                            {
+                                data.reserve(count);
+                                ring.copy(position, count, std::back_inserter(data));
+                            });
+            return data;
+        });
+    }
+
+    /**
+     * @brief               This function is used to get a statically typed channel to a queue
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @return              The channel, or std::nullopt if the queue holds data of another type
+     * @note                The type of the queue cannot change for as long as the data_pit exists
+     */
+    template<typename T>
+    std::optional<data_pit_channel<T>> channel(int queue_id)
+    {
+        // Lock the mutex for the specific queue
+        auto& q_data = queue_data(queue_id);
+        std::unique_lock lock(queue_mutex(q_data));
+
+        // Check the type of the queue once and for all
+        if (!bind_queue_type<T>(q_data, true)) return std::nullopt;
+        queue_pinned(q_data) = true;
+
+        return data_pit_channel<T>(*this, queue_id, q_data);
+    }
+
+    /**
+     * @brief               This function is used to get a handle to a consumer, which consumes without looking
+     *                      the consumer or its queue up
+     * @param   consumer_id The id of the consumer
+     * @return              The handle, or std::nullopt if the consumer is not registered
+     * @note                The handle can outlive the consumer: once the consumer is unregistered, it consumes nothing
+     */
+    std::optional<data_pit_consumer_handle> consumer_handle(unsigned int consumer_id);
+
+    /**
+     * @brief               This function is used to get a handle to a queue, which produces without looking
+     *                      the queue up
+     * @param   queue_id    The id of the queue
+     * @return              The handle
+     */
+    data_pit_producer_handle producer_handle(int queue_id);
+
+    /**
+     * @brief               This function is used to register a consumer to a queue
+     * @param   queue_id    The id of the queue
+     * @param   group_id    The id of the group of the consumer, if any: the consumers of a group share their
+     *                      position in the queue, so that every data is consumed by only one of them
+     * @return              The id of the registered consumer or 0 if the maximum number of consumers has been reached
+     * @note                A consumer of a mapped queue cannot have a group, and gets 0 if so
+     */
+    unsigned int register_consumer(int queue_id, std::optional<int> group_id = std::nullopt)
+    {
+        return add_consumer(queue_id, group_id, nullptr);
+    }
+
+    /**
+     * @brief               This function is used to register a consumer which only consumes the data matching a
+     *                      predicate, skipping the others in place
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @param   predicate   The predicate, called on the data in place when the consumer advances, in blocks of
+     *                      contiguous data which are vectorized when the predicate is simple
+     * @return              The id of the registered consumer or 0 if the maximum number of consumers has been reached
+     * @note                The consumer gets type_mismatch when consuming data of another type, and the data not
+     *                      matching still count in its lag and wake it up
+     */
+    template<typename T, typename Predicate>
+    requires std::predicate<Predicate&, const T&>
+    unsigned int register_consumer(int queue_id, Predicate predicate)
+    {
+        auto filter = std::make_unique<consumer_filter_t>(typeid(T),
+            [predicate = std::move(predicate)](ring_buffer_base& ring, index_t position, index_t end,
+                                               bool expected) mutable
+            {
+                return static_cast<ring_buffer<T>&>(ring).find_if(position, end, predicate, expected);
+            });
+        return add_consumer(queue_id, std::nullopt, std::move(filter));
+    }
+
+    /**
+     * @brief               This function is used to register a consumer which only consumes the data whose key is
+     *                      in a set, skipping the others in place
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @param   key         The function extracting the key of a data
+     * @param   keys        The keys of the data to be consumed
+     * @return              The id of the registered consumer or 0 if the maximum number of consumers has been reached
+     */
+    template<typename T, typename KeyExtractor, typename Key>
+    requires std::regular_invocable<KeyExtractor&, const T&>
+    unsigned int register_consumer(int queue_id, KeyExtractor key, std::unordered_set<Key> keys)
+    {
+        return register_consumer<T>(queue_id, [key = std::move(key), keys = std::move(keys)](const T& data) mutable
+        {
+            return keys.contains(key(data));
+        });
+    }
+
+    /**
+     * @brief               This function is used to register a consumer to a persistent queue, whose position is
+     *                      kept in the file of the queue
+     * @param   queue_id    The id of the queue
+     * @param   name        The name of the consumer, which identifies it across processes
+     * @return              The id of the registered consumer, or 0 if the queue is not persistent, the consumer is
+     *                      registered already, or the file holds the maximum number of persistent consumers
+     * @note                A consumer found in the file resumes where it was left; the data it was left before are
+     *                      retained until it is registered again or unregistered, which forgets its position
+     */
+    unsigned int register_persistent_consumer(int queue_id, uint32_t name)
+    {
+        // Check if the queue is persistent
+        if (!m_queues_data.contains(queue_id)) return 0;
+        auto& q_data = queue_data(queue_id);
+        if (q_data.mapping == nullptr) return 0;
+
+        // Register a new consumer and get its ID
+        unsigned int consumer_id = register_id();
+        if (consumer_id == 0) return 0;
+
+        // Attach the position of the consumer, skipping the data that have been cleared meanwhile
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        auto cursor = q_data.mapping->attach(name, window_start(q_data));
+        if (cursor == nullptr)
+        {
+            queue_lock.unlock();
+            unregister_id(consumer_id);
+            return 0;
         }
-        else
+        cursor->store(std::max(cursor->load(std::memory_order_relaxed), oldest_data(q_data)),
+                      std::memory_order_release);
+
+        auto c_data = std::make_shared<consumer_data_t>(queue_id, 0, nullptr, cursor);
+        m_consumers_data.insert_or_assign(consumer_id, c_data);
+        queue_consumers(q_data).push_back(c_data);
+        return consumer_id;
+    }
+
+    /**
+     * @brief               This function is used to unregister a consumer from a queue
+     * @param   consumer_id The id of the consumer to be unregistered
+     */
+    void unregister_consumer(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return;
+
+        // Remove the consumer from the consumers of the queue, so that it no longer holds any slot
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        std::erase(queue_consumers(q_data), consumer.value());
+        consumer_registered(*consumer.value()).store(false, std::memory_order_release);
+        if (consumer_readiness(*consumer.value()).is_open()) q_data.fd_watchers.fetch_sub(1, std::memory_order_relaxed);
+        if (consumer.value()->cursor != &consumer.value()->index) q_data.mapping->detach(consumer.value()->cursor);
+        notify_space(q_data);
+        queue_lock.unlock();
+
+        // Resume the coroutines of the consumer, which will find it unregistered
+        resume_async_waiters(q_data, consumer.value().get());
+
+        // Remove the consumer from the map of consumers, then release the consumer_id for future use
+        if (m_consumers_data.erase(consumer_id)) unregister_id(consumer_id);
+    }
+
+    /**
+     * @brief               This function is used to clear a specific queue
+     * @param   queue_id    The id of the queue to be cleared
+     * @note                The slots of a single_producer queue are freed as its consumers move past the cleared data
+     */
+    void clear_queue(int queue_id)
+    {
+        // Check if the queue exists
+        if (!m_queues_data.contains(queue_id)) return;
+        auto& q_data = queue_data(queue_id);
+
+        // Clear the specific queue
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        discard_all_data(q_data);
+    }
+
+    /**
+     * @brief This function is used to clear all queues
+     */
+    void clear_all_queues()
+    {
+        // Clear all queues, keeping their consumers registered
+        for (auto queue_id : m_queues_data.keys())
         {
-            // If there are no released IDs available, check if the next consumer ID has reached its maximum value
-            if(m_next_consumer_id == std::numeric_limits<unsigned int>::max())
+            auto& q_data = queue_data(queue_id);
+            std::unique_lock queue_lock(queue_mutex(q_data));
+            discard_all_data(q_data);
+
+            // The queue can take a new type, unless a channel relies on it or some data is still viewed
+            auto& ring = q_data.ring;
+            if (!queue_pinned(q_data) && ring->empty())
             {
-                // If it has, return 0
-                return 0;
+                ring = std::make_unique<ring_buffer_base>(ring->capacity(), ring->head(), ring->resource(),
+                                                          ring->placement());
+                queue_type(q_data).store(nullptr, std::memory_order_release);
             }
+        }
+    }
 
-            // If the next consumer ID has not reached its maximum value, use it and increment it
-            consumer_id = m_next_consumer_id++;
+    /**
+     * @brief               This function is used to reset a consumer's position in the queue
+     * @param   consumer_id The id of the consumer to be reset
+     * @note                Resetting a consumer of a group resets the whole group
+     */
+    void reset_consumer(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return;
+
+        // Reset the consumer's index in the queue to the oldest data within the retention of the queue
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        move_consumer(q_data, *consumer.value(), window_start(q_data));
+        queue_lock.unlock();
+        resume_async_waiters(q_data);
+        signal_consumer_fds(q_data);
+    }
+
+    /**
+     * @brief               This function is used to move a consumer to an offset of its queue, so that it consumes
+     *                      the data from there on
+     * @param   consumer_id The id of the consumer
+     * @param   offset      The offset of the next data to be consumed, as given by get_consumer_offset or
+     *                      get_queue_offsets
+     * @return              The result of the operation, offset_out_of_range if the data at the offset are no longer
+     *                      retained or not produced yet
+     * @note                Seeking a consumer of a group moves the whole group
+     */
+    data_pit_result seek(unsigned int consumer_id, uint64_t offset)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return data_pit_result::consumer_not_found;
+
+        // The offset must be within the retention of the queue, or the next data to be produced
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if (offset < window_start(q_data) || offset > queue(q_data).head()) return data_pit_result::offset_out_of_range;
+        move_consumer(q_data, *consumer.value(), offset);
+        notify_space(q_data);
+        queue_lock.unlock();
+        resume_async_waiters(q_data);
+        signal_consumer_fds(q_data);
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to move a consumer past all the data of its queue, so that it only
+     *                      consumes the data produced from now on
+     * @param   consumer_id The id of the consumer
+     * @return              The result of the operation
+     * @note                Seeking a consumer of a group moves the whole group
+     */
+    data_pit_result seek_to_latest(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return data_pit_result::consumer_not_found;
+
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        move_consumer(q_data, *consumer.value(), queue(q_data).head());
+        notify_space(q_data);
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to get the offset of the next data a consumer will consume
+     * @param   consumer_id The id of the consumer
+     * @return              The offset, or std::nullopt if the consumer does not exist
+     */
+    std::optional<uint64_t> get_consumer_offset(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
+
+        auto& q_data = queue_data(consumer_queue(*consumer.value()));
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        return consumer_position(q_data, *consumer.value());
+    }
+
+    /**
+     * @brief               This function is used to get the range of offsets a consumer of a queue can seek to
+     * @param   queue_id    The id of the queue
+     * @return              The offset of the oldest data within the retention of the queue, and the offset of the
+     *                      next data to be produced, or std::nullopt if the queue does not exist
+     */
+    std::optional<std::pair<uint64_t, uint64_t>> get_queue_offsets(int queue_id)
+    {
+        // Check if the queue exists
+        if (!m_queues_data.contains(queue_id)) return std::nullopt;
+        auto& q_data = queue_data(queue_id);
+
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        return std::make_pair(window_start(q_data), queue(q_data).head());
+    }
+
+    /**
+     * @brief               This function is used to set which data of a queue are kept for the consumers yet to come
+     * @param   queue_id    The id of the queue
+     * @param   max_count   The maximum number of the newest data retained
+     * @param   max_age_ms  The maximum age of the data retained in milliseconds, or 0 if unlimited
+     * @return              The result of the operation, policy_not_supported if the queue is mapped and max_age_ms
+     *                      is not 0, since its data may be produced by other processes
+     * @note                The consumers registered or reset start from the oldest data retained, and the consumers
+     *                      can only seek to them. The data beyond the retention are still consumed by the consumers
+     *                      which have not read them, but a queue without consumers drops them to make room for new data
+     * @note                consume_move copies the data retained instead of moving them out, so they are replayed
+     */
+    data_pit_result set_retention(int queue_id, size_t max_count, uint32_t max_age_ms = 0)
+    {
+        // Initialize the queue if it doesn't exist
+        auto& q_data = queue_data(queue_id);
+
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if (max_age_ms != 0 && q_data.mapping != nullptr) return data_pit_result::policy_not_supported;
+        q_data.retention_count = max_count;
+
+        // The data produced before the age is retained are taken as produced now
+        auto& marks = q_data.marks;
+        if (max_age_ms == 0) marks.clear();
+        else if (marks.empty()) marks.emplace_back(queue(q_data).tail(), std::chrono::steady_clock::now());
+        q_data.retention_age_ms.store(max_age_ms, std::memory_order_relaxed);
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to take a snapshot of all the data currently in a queue, which the
+     *                      producers keep appending to meanwhile
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @return              The snapshot, or std::nullopt if the queue does not exist, holds data of another type or
+     *                      is mapped
+     * @note                The data of the snapshot are retained until it is released, even if all the consumers
+     *                      consume them, so a producer of a full queue may have to wait for the snapshot
+     */
+    template<typename T>
+    std::optional<data_pit_snapshot<T>> snapshot(int queue_id)
+    {
+        std::optional<data_pit_snapshot<T>> snapshot;
+        take_snapshot<T>(queue_id, snapshot);
+        return snapshot;
+    }
+
+    /**
+     * @brief               This function is used to call a function on all the data currently in a queue, on a
+     *                      number of threads
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @param   function    The function called on each data, concurrently from the threads
+     * @param   threads     The number of threads, including the calling one, or 0 for one per hardware thread
+     * @return              The result of the operation, no_data_available if the queue does not exist,
+     *                      policy_not_supported if the queue is mapped
+     * @note                The data are left in the queue, and the data produced meanwhile are not visited
+     */
+    template<typename T, typename Function>
+    data_pit_result for_each_parallel(int queue_id, Function&& function, unsigned int threads = 0)
+    {
+        std::optional<data_pit_snapshot<T>> snapshot;
+        auto result = take_snapshot<T>(queue_id, snapshot);
+        if (result == data_pit_result::success) snapshot->for_each_parallel(function, threads);
+        return result;
+    }
+
+    /**
+     * @brief               This function is used to set the maximum size of a specific queue
+     * @param   queue_id    The id of the queue
+     * @param   size        The maximum size of the queue
+     * @note                If the queue holds more data than the new size, the oldest data are discarded
+     * @note                The size of a single_producer queue cannot change once the type of its data is known, nor
+     *                      the size of a queue while a snapshot of it is taken
+     */
+    void set_queue_size(int queue_id, size_t size)
+    {
+        // Initialize the queue if it doesn't exist
+        auto& q_data = queue_data(queue_id);
+
+        // Set the maximum size of the queue
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer && queue_type(q_data).load() != nullptr) return;
+        if (!q_data.snapshots.empty()) return;
+        queue(q_data).resize(size);
+        notify_space(q_data);
+    }
+
+    /**
+     * @brief               This function is used to set what producing does when a specific queue is full
+     * @param   queue_id    The id of the queue
+     * @param   policy      The overflow policy of the queue
+     * @param   timeout_ms  The maximum waiting time in milliseconds, if the policy is block
+     * @return              The result of the operation, policy_not_supported if the queue cannot apply the policy
+     */
+    data_pit_result set_overflow_policy(int queue_id, data_pit_overflow_policy policy,
+                                        uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // Initialize the queue if it doesn't exist
+        auto& q_data = queue_data(queue_id);
+
+        // The consumers of a single_producer queue read without locks, and those of a mapped queue may be in other
+        // processes, so their data can be neither dropped nor moved
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if ((queue_mode(q_data) == data_pit_queue_mode::single_producer || q_data.mapping != nullptr) &&
+            (policy == data_pit_overflow_policy::overwrite_oldest || policy == data_pit_overflow_policy::grow))
+        {
+            return data_pit_result::policy_not_supported;
         }
 
-        // Return the registered consumer ID
-        return consumer_id;
+        // Wake up the producers waiting under the previous policy, so that they apply the new one
+        q_data.overflow_timeout_ms.store(timeout_ms, std::memory_order_relaxed);
+        queue_overflow(q_data).store(policy, std::memory_order_relaxed);
+        queue_space(q_data).notify_all();
+        return data_pit_result::success;
     }
 
     /**
-     * @brief               This function is used to unregister a specific consumer ID
-     * @param   consumer_id The ID of the consumer to be unregistered
+     * @brief               This function is used to get the number of data dropped by the overflow policy of a queue
+     * @param   queue_id    The id of the queue
+     * @return              The number of data dropped since the queue was created, or 0 if the queue does not exist
      */
-    void unregister_id(unsigned int consumer_id)
+    uint64_t get_dropped_count(int queue_id)
     {
-        std::lock_guard lock(m_mtx);
-        released_ids.push(consumer_id);
+        // Check if the queue exists, without creating it
+        if (!m_queues_data.contains(queue_id)) return 0;
+        return queue_data(queue_id).dropped.load(std::memory_order_relaxed);
     }
 
-    // Type aliases for data structure to store the data for each queue
-    typedef std::tuple<std::pair<std::vector<std::any>, size_t>,
-                        std::string, std::unique_ptr<std::mutex>, std::condition_variable> data_t;
-    // Type aliases for queue id
-    typedef int queue_id_t;
-    // Type aliases for consumer id
-    typedef unsigned int consumer_id_t;
-    // Type aliases for index
-    typedef size_t index_t;
-    // Type aliases for data structure to store the data for each consumer
-    typedef std::tuple<queue_id_t, index_t, data_pit_result> consumer_data_t;
+    /**
+     * @brief               This function is used to set how a consumer waits for data in a blocking consume
+     * @param   consumer_id The id of the consumer
+     * @param   policy      The wait policy of the consumer
+     * @return              The result of the operation
+     */
+    data_pit_result set_wait_policy(unsigned int consumer_id, data_pit_wait_policy policy)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return data_pit_result::consumer_not_found;
 
-    // Data structure to store the data for each queue
-    concurrent_hash_map<queue_id_t, data_t> m_queues_data;
-    // Data structure to store the data for each consumer
-    concurrent_hash_map<consumer_id_t, consumer_data_t> m_consumers_data;
-    // Mutex for thread safety
-    std::mutex m_mtx;
-    // Next consumer ID
-    unsigned int m_next_consumer_id;
-    // Queue of released IDs
-    std::queue<unsigned int> released_ids;
-};
\ No newline at end of file
+        consumer_policy(*consumer.value()).store(policy, std::memory_order_relaxed);
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to get the last error of a specific consumer
+     * @param   consumer_id The id of the consumer
+     * @return              The last error of the consumer
+     */
+    data_pit_result get_last_error(unsigned int consumer_id)
+    {
+        // Check if consumer_id exists
+        auto consumer = m_consumers_data.find(consumer_id);
+        if (!consumer.has_value())
+        {
+            // If the consumer_id does not exist, return a consumer not found error
+            return data_pit_result::consumer_not_found;
+        }
+
+        // Return the last error of the consumer
+        return data_pit_error(*consumer.value()).load(std::memory_order_relaxed);
+    }
+
+private:
+    template<typename>
+    friend class data_pit_channel;
+    template<typename>
+    friend class data_pit_view;
+    friend class data_pit_consumer_handle;
+    friend class data_pit_producer_handle;
+    template<typename, typename>
+    friend class data_pit_awaitable;
+    template<typename>
+    friend class data_pit_static_consumer;
+    template<typename...>
+    friend class data_pit_static;
+    template<typename>
+    friend class data_pit_snapshot;
+
+    // Type aliases for queue id
+    typedef int queue_id_t;
+    // Type aliases for consumer id
+    typedef unsigned int consumer_id_t;
+    // Type aliases for index
+    typedef uint64_t index_t;
+
+    // The hold of a consumer that views no data
+    static constexpr index_t no_hold = std::numeric_limits<index_t>::max();
+
+    // Type aliases for data structure to store the index shared by a group of consumers
+    typedef std::tuple<int, std::atomic<uint64_t>> consumer_group_t;
+
+    /**
+     * @brief Data structure to store the filter of a consumer
+     */
+    struct consumer_filter_t
+    {
+        consumer_filter_t(const std::type_info& type,
+                          std::function<index_t(ring_buffer_base&, index_t, index_t, bool)> find)
+            : type(type), find(std::move(find)) {}
+
+        // The type of the data the filter takes
+        const std::type_info& type;
+        // The function finding the first data of a range of a ring buffer of that type whose match is as expected,
+        // or the end of the range
+        std::function<index_t(ring_buffer_base&, index_t, index_t, bool)> find;
+    };
+
+    /**
+     * @brief Data structure to store the data for each consumer
+     *
+     * Its fields are only written by the consumer itself, and it takes whole cache lines, so that consumers running
+     * on different threads never write to the same cache line.
+     */
+    struct alignas(DATA_PIT_CACHE_LINE_SIZE) consumer_data_t
+    {
+        consumer_data_t(int queue_id, index_t index, std::shared_ptr<consumer_group_t> group,
+                        std::atomic<index_t>* cursor = nullptr, std::unique_ptr<consumer_filter_t> filter = nullptr)
+            : queue_id(queue_id), group(std::move(group)), index(index),
+              cursor(cursor != nullptr ? cursor : &this->index), filter(std::move(filter)) {}
+
+        // The id of the queue
+        const int queue_id;
+        // The group of the consumer, or nullptr if it has none
+        const std::shared_ptr<consumer_group_t> group;
+        // The position of the next data to be consumed, unless the consumer has a group or is persistent
+        std::atomic<index_t> index;
+        // The position of the consumer without a group: its index, or its position in the file of its queue
+        std::atomic<index_t>* const cursor;
+        // The filter of the consumer, which has no group, or nullptr
+        const std::unique_ptr<consumer_filter_t> filter;
+        // The last error
+        std::atomic<data_pit_result> error{data_pit_result::success};
+        // The position of the data viewed by the consumer, or no_hold
+        std::atomic<index_t> hold{no_hold};
+        // The position of the data claimed by the consumer from its group while it reads them, or no_hold
+        std::atomic<index_t> hazard{no_hold};
+        // The position a seek moved the consumer forward to, which a consumer of a single_producer queue without a
+        // group moves to itself, since it reads without the mutex
+        std::atomic<index_t> seek{0};
+        // How the consumer waits for data
+        std::atomic<data_pit_wait_policy> policy{data_pit_wait_policy::block};
+        // Whether the consumer is registered, since it stays alive while a handle refers to it
+        std::atomic<bool> registered{true};
+        // The file descriptor readable while the consumer has data available, opened on request
+        event_fd readiness;
+    };
+
+    /**
+     * @brief Data structure to store a coroutine suspended until its consumer has data available
+     */
+    struct async_waiter_t
+    {
+        // The consumer of the coroutine
+        consumer_data_t* consumer;
+        // The function resuming the coroutine on its executor, given the waiter
+        void (*schedule)(async_waiter_t&);
+        // The awaitable of the coroutine
+        void* context;
+        // The next waiter of the queue
+        async_waiter_t* next = nullptr;
+    };
+
+    /**
+     * @brief Data structure to store the data for each queue
+     *
+     * The fields read on every call are kept apart from the mutex, which the producers and consumers of a
+     * multi_producer queue write, and from the sequence the producers advance on every call. The head and the
+     * tail of the ring buffer are on cache lines of their own too.
+     */
+    struct data_t
+    {
+        // The ring buffer, a plain ring_buffer_base until the type of the queue is known, then a ring_buffer<T>
+        alignas(DATA_PIT_CACHE_LINE_SIZE) std::unique_ptr<ring_buffer_base> ring;
+        // The type of the data, or nullptr if it is not known yet
+        std::atomic<const std::type_info*> type{nullptr};
+        // The position of the first data not cleared
+        std::atomic<index_t> floor{0};
+        // The floor and the sequences, which are kept in the mapping of a mapped queue
+        std::atomic<index_t>* floor_ref = &floor;
+        wait_sequence* signal_ref = &signal;
+        wait_sequence* space_ref = &space;
+        // The mode of the queue
+        data_pit_queue_mode mode = data_pit_queue_mode::multi_producer;
+        // Whether the type of the queue can no longer change
+        bool pinned = false;
+        // What producing does when the queue is full
+        std::atomic<data_pit_overflow_policy> overflow{data_pit_overflow_policy::reject};
+        // How long producing waits when the queue is full and its overflow policy is block, in milliseconds
+        std::atomic<uint32_t> overflow_timeout_ms{std::numeric_limits<uint32_t>::max()};
+        // The maximum number of the newest data offered to the consumers yet to come
+        size_t retention_count = std::numeric_limits<size_t>::max();
+        // The maximum age of the data offered to the consumers yet to come in milliseconds, or 0 if unlimited
+        std::atomic<uint32_t> retention_age_ms{0};
+        // The position of the first data produced in each millisecond, and when, while retention_age_ms is set
+        std::deque<std::pair<index_t, std::chrono::steady_clock::time_point>> marks;
+        // The consumers registered to the queue
+        std::vector<std::shared_ptr<consumer_data_t>> consumers;
+        // The position of the first data of each snapshot of the queue which holds data
+        std::multiset<index_t> snapshots;
+        // The file the ring buffer is mapped from, which the ring buffer owns, or nullptr
+        mapped_ring* mapping = nullptr;
+        // The mutex of the queue
+        alignas(DATA_PIT_CACHE_LINE_SIZE) std::mutex mutex;
+        // The sequence the consumers wait on
+        alignas(DATA_PIT_CACHE_LINE_SIZE) wait_sequence signal;
+        // The number of data dropped by the overflow policy
+        std::atomic<uint64_t> dropped{0};
+        // The coroutines suspended until their consumer has data available, linked under the mutex
+        std::atomic<async_waiter_t*> async_waiters{nullptr};
+        // The number of consumers whose file descriptor is open
+        std::atomic<uint32_t> fd_watchers{0};
+        // The sequence the producers wait on when the queue is full, which advances as the consumers free slots
+        alignas(DATA_PIT_CACHE_LINE_SIZE) wait_sequence space;
+#if DATA_PIT_STATS
+        // The statistics of the queue
+        alignas(DATA_PIT_CACHE_LINE_SIZE) data_pit_stats stats;
+#endif
+    };
+
+    /**
+     * @brief               This function is used to initialize a queue
+     * @param   q_data      The data of the queue, not yet visible to other threads
+     * @param   options     The options of the queue
+     */
+    inline void init_queue(data_t& q_data, const data_pit_queue_options& options)
+    {
+        // Create an untyped ring buffer with the maximum size of the queue, which allocates no slot yet
+        ring_buffer_placement placement;
+        placement.power_of_two = options.power_of_two;
+        placement.prefault = options.prefault;
+        placement.numa_node = options.numa_node;
+        q_data.ring = std::make_unique<ring_buffer_base>(options.capacity, 0,
+                                                         options.resource != nullptr ? options.resource : m_resource,
+                                                         placement);
+
+        // The storage of a single_producer queue is read without locks, so its type never changes once known
+        queue_mode(q_data) = options.mode;
+        queue_pinned(q_data) = options.mode == data_pit_queue_mode::single_producer;
+    }
+
+    /**
+     * @brief               This function is used to register a consumer to a queue
+     * @param   queue_id    The id of the queue
+     * @param   group_id    The id of the group of the consumer, if any
+     * @param   filter      The filter of the consumer, or nullptr
+     * @return              The id of the registered consumer, or 0
+     */
+    unsigned int add_consumer(int queue_id, std::optional<int> group_id, std::unique_ptr<consumer_filter_t> filter)
+    {
+        // Register a new consumer and get its ID
+        unsigned int consumer_id = register_id();
+
+        // If the consumer_id is 0, it means that the maximum number of consumers has been reached
+        if(consumer_id == 0) return 0;
+
+        // Lock the mutex for the specific queue so that no slot is reclaimed meanwhile
+        auto& q_data = queue_data(queue_id);
+        std::unique_lock queue_lock(queue_mutex(q_data));
+
+        // The consumers of a mapped queue keep their position in the mapping, where groups cannot be shared
+        std::atomic<index_t>* cursor = nullptr;
+        if (q_data.mapping != nullptr)
+        {
+            cursor = group_id.has_value() ? nullptr : q_data.mapping->attach_anonymous(window_start(q_data));
+            if (cursor == nullptr)
+            {
+                queue_lock.unlock();
+                unregister_id(consumer_id);
+                return 0;
+            }
+        }
+
+        // Join the group of the consumer, creating it if it has no consumers yet
+        std::shared_ptr<consumer_group_t> group;
+        if (group_id.has_value())
+        {
+            for (auto& other : queue_consumers(q_data))
+            {
+                auto& other_group = consumer_group(*other);
+                if (other_group != nullptr && std::get<0>(*other_group) == *group_id) group = other_group;
+            }
+            if (group == nullptr) group = std::make_shared<consumer_group_t>(*group_id, window_start(q_data));
+        }
+
+        // Create the consumer
+        // The consumer is associated with the queue_id, its index in the queue (initially the oldest data within
+        // the retention of the queue) and its group, and starts with no error, no data viewed or claimed, and the
+        // block wait policy
+        auto c_data = std::make_shared<consumer_data_t>(queue_id, window_start(q_data), group, cursor,
+                                                        std::move(filter));
+
+        // Add the consumer to the map of consumers and to the consumers of the queue
+        m_consumers_data.insert_or_assign(consumer_id, c_data);
+        queue_consumers(q_data).push_back(c_data);
+
+        // Return the consumer_id
+        return consumer_id;
+    }
+
+    /**
+     * @brief               This function is used to take a snapshot of all the data currently in a queue
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @param   snapshot    The destination of the snapshot
+     * @return              The result of the operation, no_data_available if the queue does not exist,
+     *                      policy_not_supported if the queue is mapped
+     */
+    template<typename T>
+    data_pit_result take_snapshot(int queue_id, std::optional<data_pit_snapshot<T>>& snapshot)
+    {
+        // Check if the queue exists
+        if (!m_queues_data.contains(queue_id)) return data_pit_result::no_data_available;
+        auto& q_data = queue_data(queue_id);
+
+        // The data of a mapped queue may be reclaimed by the producers of other processes
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        if (q_data.mapping != nullptr) return data_pit_result::policy_not_supported;
+        if (!bind_queue_type<T>(q_data, false)) return data_pit_result::type_mismatch;
+
+        // Pin the data from the oldest one a consumer can read, so that their slots are neither reclaimed nor moved
+        auto& ring = typed_queue<T>(q_data);
+        auto begin = oldest_data(q_data);
+        auto end = ring.head();
+        if (begin < end) q_data.snapshots.insert(begin);
+        snapshot.emplace(data_pit_snapshot<T>(*this, q_data, ring, begin, end));
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to get the position of the oldest data pinned by a snapshot
+     * @param   q_data      The data of the queue
+     * @return              The position of the oldest data pinned, or no_hold if there is none
+     * @note                The mutex of the queue must be locked
+     */
+    inline index_t pinned_data(data_t& q_data)
+    {
+        return q_data.snapshots.empty() ? no_hold : *q_data.snapshots.begin();
+    }
+
+    /**
+     * @brief               This function is used to create a queue whose ring buffer is mapped from a file or a
+     *                      shared memory object
+     * @tparam  T           The type of the data of the queue
+     * @param   queue_id    The id of the queue
+     * @param   mapping     The mapped slots, or nullptr if they could not be mapped
+     * @param   mode        The mode of the queue
+     * @return              The result of the operation
+     */
+    template<typename T>
+    data_pit_result create_mapped_queue(int queue_id, std::unique_ptr<mapped_ring> mapping, data_pit_queue_mode mode)
+    {
+        if (mapping == nullptr) return data_pit_result::storage_error;
+        if (!mapping->holds(sizeof(T), alignof(T))) return data_pit_result::type_mismatch;
+
+        // The type of the queue never changes, since its storage is typed
+        bool created = false;
+        m_queues_data.find_or_insert(queue_id, [&](data_t& q_data)
+        {
+            data_pit_queue_options options;
+            options.mode = mode;
+            options.capacity = mapping->header().capacity;
+            init_queue(q_data, options);
+
+            // The state shared with the other processes is kept in the mapping
+            auto& header = mapping->header();
+            q_data.floor_ref = &header.floor;
+#if defined(__linux__)
+            q_data.signal_ref = &header.signal;
+            q_data.space_ref = &header.space;
+#endif
+            q_data.mapping = mapping.get();
+            q_data.ring = std::make_unique<ring_buffer<T>>(std::move(mapping));
+            queue_type(q_data).store(&typeid(T), std::memory_order_release);
+            queue_pinned(q_data) = true;
+            created = true;
+        });
+
+        return created ? data_pit_result::success : data_pit_result::queue_already_exists;
+    }
+
+    /**
+     * @brief               This function is used to check if a queue is known to hold data of a specific type
+     * @tparam  T           The type of the data
+     * @param   q_data      The data of the queue
+     * @return              True if the queue holds data of type T, false otherwise
+     */
+    template<typename T>
+    bool queue_has_type(data_t& q_data)
+    {
+        auto type = queue_type(q_data).load(std::memory_order_acquire);
+        return type != nullptr && *type == typeid(T);
+    }
+
+    /**
+     * @brief               This function is used to check the type of the data of a queue
+     * @tparam  T           The type of the data
+     * @param   q_data      The data of the queue
+     * @param   rebind      If true, a queue holding no data takes the type T even if it had another type
+     * @return              True if the queue holds data of type T, false otherwise
+     * @note                The mutex of the queue must be locked
+     */
+    template<typename T>
+    bool bind_queue_type(data_t& q_data, bool rebind)
+    {
+        if (queue_has_type<T>(q_data)) return true;
+
+        // Only a queue holding no data can change its type
+        auto& ring = q_data.ring;
+        auto& type = queue_type(q_data);
+        if (type.load() != nullptr && (!rebind || !ring->empty() || queue_pinned(q_data))) return false;
+
+        // Replace the storage with a ring buffer of T, keeping the sequence numbers of the queue
+        ring = std::make_unique<ring_buffer<T>>(ring->capacity(), ring->head(), ring->resource(), ring->placement());
+        type.store(&typeid(T), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief               This function is used to produce data in a queue, according to the mode of the queue
+     * @tparam  T           The type of the data
+     * @param   q_data      The data of the queue
+     * @param   count       The number of data to be produced
+     * @param   check_type  If false, the queue is known to hold data of type T
+     * @param   write       The function appending the data to the ring buffer of the queue
+     * @return              The result of the operation
+     * @note                Either all the data are produced or none of them
+     */
+    template<typename T, typename Writer>
+    data_pit_result produce_data(data_t& q_data, size_t count, bool check_type, Writer&& write)
+    {
+        auto result = produce_to_queue<T>(q_data, count, check_type, write);
+#if DATA_PIT_STATS
+        if (result == data_pit_result::success) q_data.stats.record_produced(count);
+        record_result(q_data, result);
+#endif
+        return result;
+    }
+
+    /**
+     * @brief               This function is used to produce data in a queue, as in produce_data, without recording
+     *                      statistics
+     */
+    template<typename T, typename Writer>
+    data_pit_result produce_to_queue(data_t& q_data, size_t count, bool check_type, Writer& write)
+    {
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer)
+        {
+            // The mutex is only needed until the type of the queue is known
+            if (check_type && !queue_has_type<T>(q_data))
+            {
+                std::unique_lock lock(queue_mutex(q_data));
+                if (!bind_queue_type<T>(q_data, true)) return data_pit_result::type_mismatch;
+            }
+
+            // Reclaiming slots needs the mutex, since consumers may be registered or reset meanwhile
+            auto& ring = typed_queue<T>(q_data);
+            if (ring.capacity() - ring.size() < count)
+            {
+                std::unique_lock lock(queue_mutex(q_data));
+                auto result = make_room<T>(q_data, count, lock);
+                if (result != data_pit_result::success) return result;
+            }
+
+            // The age of the data is only recorded when the queue retains data by age
+            if (q_data.retention_age_ms.load(std::memory_order_relaxed) != 0)
+            {
+                std::unique_lock lock(queue_mutex(q_data));
+                record_mark(q_data, ring.head());
+            }
+
+            // Add the data to the queue, publishing them to the consumers, then wake up the waiting ones
+            write(ring);
+            queue_signal(q_data).notify_all();
+            notify_pollers();
+            resume_async_waiters(q_data);
+            signal_consumer_fds(q_data);
+
+            // Return success
+            return data_pit_result::success;
+        }
+
+        // Lock the mutex for the specific queue
+        auto lock = lock_queue(q_data);
+
+        // Check if the type of the data matches the data already in the queue
+        if (check_type && !bind_queue_type<T>(q_data, true))
+        {
+            // If the type of the data does not match, return a type mismatch error
+            return data_pit_result::type_mismatch;
+        }
+
+        // If the queue is full, make room as the overflow policy of the queue says
+        if (queue(q_data).capacity() - queue(q_data).size() < count)
+        {
+            auto result = make_room<T>(q_data, count, lock);
+            if (result != data_pit_result::success) return result;
+        }
+
+        // Add the data to the queue, recording their age if the queue retains data by age
+        if (q_data.retention_age_ms.load(std::memory_order_relaxed) != 0) record_mark(q_data, queue(q_data).head());
+        write(typed_queue<T>(q_data));
+
+        // Notify the waiting threads that new data has been added, once the mutex is free for them
+        lock.unlock();
+        queue_signal(q_data).notify_all();
+        notify_pollers();
+        resume_async_waiters(q_data);
+        signal_consumer_fds(q_data);
+
+        // Return success
+        return data_pit_result::success;
+    }
+
+    /**
+     * @brief               This function is used to consume data from a queue, according to the mode of the queue
+     * @tparam  T           The type of the data
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @param   check_type  If false, the queue is known to hold data of type T
+     * @param   max_count   The maximum number of data to be consumed
+     * @param   read        The function reading the data from the ring buffer of the queue, given the position of
+     *                      the first data and the number of data to be read
+     * @return              The number of data consumed
+     */
+    template<typename T, typename Reader>
+    size_t consume_data(data_t& q_data, consumer_data_t& c_data, bool blocking, uint32_t timeout_ms,
+                        bool check_type, size_t max_count, Reader&& read)
+    {
+#if DATA_PIT_STATS
+        auto start = blocking ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+#endif
+        auto count = consume_from_queue<T>(q_data, c_data, blocking, timeout_ms, check_type, max_count, read);
+#if DATA_PIT_STATS
+        if (count > 0) q_data.stats.record_consumed(count);
+        else record_result(q_data, data_pit_error(c_data).load(std::memory_order_relaxed));
+        if (blocking) q_data.stats.record_wait(std::chrono::steady_clock::now() - start);
+#endif
+        return count;
+    }
+
+    /**
+     * @brief               This function is used to consume data from a queue, as in consume_data, without
+     *                      recording statistics
+     */
+    template<typename T, typename Reader>
+    size_t consume_from_queue(data_t& q_data, consumer_data_t& c_data, bool blocking, uint32_t timeout_ms,
+                              bool check_type, size_t max_count, Reader& read)
+    {
+        // The filter of the consumer takes data of a single type
+        if (c_data.filter != nullptr && c_data.filter->type != typeid(T))
+        {
+            data_pit_error(c_data).store(data_pit_result::type_mismatch, std::memory_order_relaxed);
+            return 0;
+        }
+
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer)
+        {
+            // The mutex is only needed until the type of the queue is known
+            if (check_type && !queue_has_type<T>(q_data))
+            {
+                std::unique_lock lock(queue_mutex(q_data));
+
+                // If no data has been produced yet, the queue takes the type of the consumer
+                if (!bind_queue_type<T>(q_data, false))
+                {
+                    data_pit_error(c_data).store(data_pit_result::type_mismatch, std::memory_order_relaxed);
+                    return 0;
+                }
+            }
+
+            return consume_data_single<T>(q_data, c_data, blocking, timeout_ms, max_count, read);
+        }
+
+        // Lock the mutex for the specific queue
+        auto queue_lock = lock_queue(q_data);
+
+        // If no data has been produced yet, the queue takes the type of the consumer
+        if (check_type && !bind_queue_type<T>(q_data, false))
+        {
+            data_pit_error(c_data).store(data_pit_result::type_mismatch, std::memory_order_relaxed);
+            return 0;
+        }
+
+        // Get the index of the consumer, skipping the data that has been discarded meanwhile
+        auto& index = consumer_index(c_data);
+        auto position = std::max(index.load(std::memory_order_relaxed), oldest_data(q_data));
+        auto deadline = blocking ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)
+                                 : std::chrono::steady_clock::time_point();
+
+        // If blocking is true, wait until there are data available
+        // A consumer with a filter waits again when it skipped all the data produced meanwhile
+        while (true)
+        {
+            if (blocking)
+            {
+                auto& signal = queue_signal(q_data);
+                while (position >= queue(q_data).head())
+                {
+                    // Wait without the mutex, so that producers and other consumers are not held up
+                    auto sequence = signal.load();
+                    queue_lock.unlock();
+                    auto woken = wait_signal(q_data, c_data, sequence, deadline);
+                    queue_lock.lock();
+
+                    // The consumer may have been reset and the queue cleared while waiting
+                    position = std::max(index.load(std::memory_order_relaxed), oldest_data(q_data));
+                    if (!woken && position >= queue(q_data).head())
+                    {
+                        // Timeout expired
+                        data_pit_error(c_data).store(data_pit_result::timeout_expired, std::memory_order_relaxed);
+                        return 0;
+                    }
+                }
+
+                // The type of the queue may have changed while waiting
+                if (!bind_queue_type<T>(q_data, false))
+                {
+                    data_pit_error(c_data).store(data_pit_result::type_mismatch, std::memory_order_relaxed);
+                    return 0;
+                }
+            }
+
+            // If there are no data available, return
+            auto head = queue(q_data).head();
+            if (position >= head)
+            {
+                data_pit_error(c_data).store(data_pit_result::no_data_available, std::memory_order_relaxed);
+                return 0;
+            }
+
+            // Fetch the data from the queue and move the consumer's index past them, releasing the data it viewed
+            // The consumers of a group share their index, and the mutex makes them read different data
+            release_hold(c_data);
+            auto [end, count] = read_data(c_data, typed_queue<T>(q_data), position, head, max_count, read);
+            index.store(end, std::memory_order_release);
+            position = end;
+            if (count == 0 && blocking)
+            {
+                notify_space(q_data);
+                continue;
+            }
+
+            // The slots of the data may be reclaimed now, so wake up the producers waiting for room
+            queue_lock.unlock();
+            notify_space(q_data);
+            if (count == 0)
+            {
+                data_pit_error(c_data).store(data_pit_result::no_data_available, std::memory_order_relaxed);
+            }
+            return count;
+        }
+    }
+
+    /**
+     * @brief               This function is used to read the data available to a consumer, skipping the data its
+     *                      filter does not match
+     * @tparam  T           The type of the data, which must be the type of the queue
+     * @param   c_data      The data of the consumer
+     * @param   ring        The ring buffer of the queue
+     * @param   position    The position of the first data available, which must be retained
+     * @param   head        The position past the last data available
+     * @param   max_count   The maximum number of data to be read
+     * @param   read        The function reading the data, as in consume_data, which is called on every run of
+     *                      data matching the filter
+     * @return              The position past the data read or skipped, and the number of data read
+     */
+    template<typename T, typename Reader>
+    std::pair<index_t, size_t> read_data(consumer_data_t& c_data, ring_buffer<T>& ring, index_t position,
+                                         index_t head, size_t max_count, Reader& read)
+    {
+        auto& filter = c_data.filter;
+        if (filter == nullptr)
+        {
+            auto count = std::min(max_count, static_cast<size_t>(head - position));
+            read(ring, position, count);
+            return {position + count, count};
+        }
+
+        // Skip the data not matching, then read the run of data matching, until enough data are read
+        size_t count = 0;
+        while (count < max_count && position < head)
+        {
+            auto first = filter->find(ring, position, head, true);
+            if (first == head) return {head, count};
+            auto last = filter->find(ring, first, std::min<index_t>(head, first + (max_count - count)), false);
+            read(ring, first, static_cast<size_t>(last - first));
+            count += static_cast<size_t>(last - first);
+            position = last;
+        }
+        return {position, count};
+    }
+
+    /**
+     * @brief               This function is used to consume data from a single_producer queue
+     * @tparam  T           The type of the data, which must be the type of the queue
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @param   max_count   The maximum number of data to be consumed
+     * @param   read        The function reading the data, as in consume_data
+     * @return              The number of data consumed
+     */
+    template<typename T, typename Reader>
+    size_t consume_data_single(data_t& q_data, consumer_data_t& c_data, bool blocking, uint32_t timeout_ms,
+                               size_t max_count, Reader& read)
+    {
+        auto& ring = typed_queue<T>(q_data);
+        auto& index = consumer_index(c_data);
+        auto deadline = blocking ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)
+                                 : std::chrono::steady_clock::time_point();
+
+        while (true)
+        {
+            auto position = index.load(std::memory_order_acquire);
+
+            // Skip the data that has been cleared or sought past meanwhile
+            auto floor = std::max(queue_floor(q_data).load(std::memory_order_acquire),
+                                  consumer_seek(c_data).load(std::memory_order_acquire));
+            if (position < floor)
+            {
+                if (index.compare_exchange_strong(position, floor, std::memory_order_acq_rel)) notify_space(q_data);
+                continue;
+            }
+
+            auto head = ring.head();
+            if (position >= head)
+            {
+                // If there are no data available, return
+                if (!blocking)
+                {
+                    data_pit_error(c_data).store(data_pit_result::no_data_available, std::memory_order_relaxed);
+                    return 0;
+                }
+
+                // Wait until there are data available
+                if (!wait_data_single(q_data, c_data, deadline))
+                {
+                    data_pit_error(c_data).store(data_pit_result::timeout_expired, std::memory_order_relaxed);
+                    return 0;
+                }
+                continue;
+            }
+
+            auto count = std::min(max_count, static_cast<size_t>(head - position));
+            if (consumer_group(c_data) != nullptr)
+            {
+                // Another consumer of the group may claim the data first, so protect them before claiming them:
+                // once claimed, the index of the group no longer points to them
+                auto& hazard = consumer_hazard(c_data);
+                hazard.store(position, std::memory_order_release);
+                if (!index.compare_exchange_strong(position, position + count, std::memory_order_acq_rel))
+                {
+                    hazard.store(no_hold, std::memory_order_release);
+                    continue;
+                }
+
+                release_hold(c_data);
+                read(ring, position, count);
+                hazard.store(no_hold, std::memory_order_release);
+                notify_space(q_data);
+                return count;
+            }
+
+            // The slots cannot be reclaimed while the index of the consumer points to them, so the data it
+            // viewed can be released
+            release_hold(c_data);
+            auto [end, read_count] = read_data(c_data, ring, position, head, max_count, read);
+
+            // Move past the data, unless the consumer has been reset meanwhile: the data read are still
+            // valid, and the consumer will read them again from its new position
+            index.compare_exchange_strong(position, end, std::memory_order_acq_rel);
+            notify_space(q_data);
+
+            // A consumer with a filter looks for data again when it skipped all the data available
+            if (read_count == 0) continue;
+            return read_count;
+        }
+    }
+
+    /**
+     * @brief               This function is used to get a reader moving the data out of a queue when possible
+     * @tparam  T           The type of the data, which must be the type of the queue
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   data        The destination of the data
+     * @return              The reader, as in consume_data
+     */
+    template<typename T>
+    auto move_reader(data_t& q_data, consumer_data_t& c_data, std::optional<T>& data)
+    {
+        return [this, &q_data, &c_data, &data](ring_buffer<T>& ring, index_t position, size_t)
+        {
+            // The consumers of a single_producer queue do not lock the mutex, which is needed to discard data
+            std::unique_lock<std::mutex> lock;
+            if (queue_mode(q_data) == data_pit_queue_mode::single_producer) lock = std::unique_lock(queue_mutex(q_data));
+
+            // The data of a mapped queue are trivially copyable, and may be read by the consumers of other processes,
+            // and the data within the retention of the queue are kept for the consumers yet to come
+            if (q_data.mapping != nullptr || !last_reader(q_data, c_data, position) || retained(q_data, position))
+            {
+                data.emplace(ring.at(position));
+                return;
+            }
+
+            // No consumer reads the data again, so discard it once moved out
+            data.emplace(std::move(ring.at(position)));
+            ring.discard_until(position + 1);
+        };
+    }
+
+    /**
+     * @brief               This function is used to check if some data are kept for the consumers yet to come by the
+     *                      retention of their queue
+     * @param   q_data      The data of the queue
+     * @param   position    The position of the data
+     * @return              True if the queue has a retention and the data are within it, false otherwise
+     * @note                The mutex of the queue must be locked
+     */
+    inline bool retained(data_t& q_data, index_t position)
+    {
+        if (q_data.retention_count == std::numeric_limits<size_t>::max() &&
+            q_data.retention_age_ms.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+        return position >= window_start(q_data);
+    }
+
+    /**
+     * @brief               This function is used to check if a consumer is the last one needing some data
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   position    The position of the data, which the consumer is reading
+     * @return              True if all the other consumers have moved past the data, false otherwise
+     * @note                The mutex of the queue must be locked
+     */
+    inline bool last_reader(data_t& q_data, consumer_data_t& c_data, index_t position)
+    {
+        // A consumer of a single_producer queue reads without the mutex, so it may have been reset meanwhile,
+        // unless it claimed the data from its group
+        auto& group = consumer_group(c_data);
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer && group == nullptr &&
+            consumer_index(c_data).load(std::memory_order_acquire) != position)
+        {
+            return false;
+        }
+
+        // The data pinned by a snapshot may be read by its threads
+        if (pinned_data(q_data) <= position) return false;
+
+        for (auto& other : queue_consumers(q_data))
+        {
+            if (other.get() == &c_data) continue;
+
+            // The other consumers of the group only need the data they view or read
+            auto retained = group != nullptr && consumer_group(*other) == group
+                            ? std::min(consumer_hold(*other).load(std::memory_order_acquire),
+                                       consumer_hazard(*other).load(std::memory_order_acquire))
+                            : retained_data(q_data, *other);
+            if (retained <= position) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief               This function is used to get a reader viewing the data of a queue
+     * @tparam  T           The type of the data, which must be the type of the queue
+     * @param   c_data      The data of the consumer
+     * @param   view        The destination of the view
+     * @return              The reader, as in consume_data
+     */
+    template<typename T>
+    auto view_reader(const std::shared_ptr<consumer_data_t>& c_data, std::optional<data_pit_view<T>>& view)
+    {
+        return [this, &c_data, &view](ring_buffer<T>& ring, index_t position, size_t)
+        {
+            // Hold the slot before the index of the consumer moves past it
+            consumer_hold(*c_data).store(position, std::memory_order_release);
+            view.emplace(data_pit_view<T>(*this, c_data, ring.at(position), position));
+        };
+    }
+
+    /**
+     * @brief               This function is used to release the data viewed by a consumer
+     * @param   c_data      The data of the consumer
+     */
+    inline void release_hold(consumer_data_t& c_data)
+    {
+        auto& hold = consumer_hold(c_data);
+        if (hold.load(std::memory_order_relaxed) != no_hold) hold.store(no_hold, std::memory_order_release);
+    }
+
+    /**
+     * @brief               This function is used to get the position of the oldest data a consumer still needs
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @return              The position of the oldest data needed by the consumer
+     * @note                The mutex of the queue must be locked
+     */
+    inline index_t retained_data(data_t& q_data, consumer_data_t& c_data)
+    {
+        // The index is loaded first, so that the hold and the hazard set before the index moved past them are seen
+        auto index = consumer_index(c_data).load(std::memory_order_acquire);
+        auto hold = std::min(consumer_hold(c_data).load(std::memory_order_acquire),
+                             consumer_hazard(c_data).load(std::memory_order_acquire));
+
+        // The consumers of a multi_producer queue skip the cleared data under the mutex, while the consumers of a
+        // single_producer queue may still be reading them
+        if (queue_mode(q_data) == data_pit_queue_mode::multi_producer)
+        {
+            index = std::max(index, queue_floor(q_data).load(std::memory_order_relaxed));
+        }
+        return std::min(index, hold);
+    }
+
+    /**
+     * @brief               This function is used to wait for the data of a consumer of a single_producer queue
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   deadline    The time at which the wait expires
+     * @return              True if there are data available, false if the wait expired
+     */
+    bool wait_data_single(data_t& q_data, consumer_data_t& c_data, std::chrono::steady_clock::time_point deadline)
+    {
+        auto& signal = queue_signal(q_data);
+        while (true)
+        {
+            // Read the sequence before checking for data, so that no notification is missed
+            auto sequence = signal.load();
+            auto position = std::max({consumer_index(c_data).load(std::memory_order_acquire),
+                                      consumer_seek(c_data).load(std::memory_order_acquire),
+                                      queue_floor(q_data).load(std::memory_order_acquire)});
+            if (position < queue(q_data).head()) return true;
+            if (!wait_signal(q_data, c_data, sequence, deadline)) return false;
+        }
+    }
+
+    /**
+     * @brief               This function is used to wait for the sequence of a queue, according to the wait policy
+     *                      of a consumer
+     * @param   q_data      The data of the queue
+     * @param   c_data      The data of the consumer
+     * @param   sequence    The value of the sequence read before checking for data
+     * @param   deadline    The time at which the wait expires
+     * @return              False if the wait expired, true otherwise
+     */
+    inline bool wait_signal(data_t& q_data, consumer_data_t& c_data, uint32_t sequence,
+                            std::chrono::steady_clock::time_point deadline)
+    {
+        auto& signal = queue_signal(q_data);
+        switch (consumer_policy(c_data).load(std::memory_order_relaxed))
+        {
+            case data_pit_wait_policy::spin:
+                return signal.spin_until(sequence, deadline);
+            case data_pit_wait_policy::spin_then_block:
+                if (signal.spin_until(sequence, deadline, DATA_PIT_SPIN_COUNT)) return true;
+                return signal.wait_until(sequence, deadline);
+            default:
+                return signal.wait_until(sequence, deadline);
+        }
+    }
+
+    /**
+     * @brief               This function is used to make room for data in a full queue, as its overflow policy says
+     * @tparam  T           The type of the data
+     * @param   q_data      The data of the queue
+     * @param   count       The number of data to make room for
+     * @param   lock        The lock of the mutex of the queue, which is unlocked while waiting for room
+     * @return              success if there is room for the data, the result of producing them otherwise
+     */
+    template<typename T>
+    data_pit_result make_room(data_t& q_data, size_t count, std::unique_lock<std::mutex>& lock)
+    {
+        auto& space = queue_space(q_data);
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        bool expired = false;
+        while (true)
+        {
+            // Read the sequence before checking for room, so that no slot freed meanwhile is missed
+            auto sequence = space.load();
+            auto& ring = queue(q_data);
+            if (ring.capacity() - ring.size() >= count || reclaim_slots(q_data, count))
+            {
+                return data_pit_result::success;
+            }
+
+            switch (queue_overflow(q_data).load(std::memory_order_relaxed))
+            {
+            case data_pit_overflow_policy::block:
+                break;
+            case data_pit_overflow_policy::overwrite_oldest:
+                return overwrite_slots(q_data, count) ? data_pit_result::success : data_pit_result::queue_is_full;
+            case data_pit_overflow_policy::drop_newest:
+                q_data.dropped.fetch_add(count, std::memory_order_relaxed);
+                return data_pit_result::data_dropped;
+            case data_pit_overflow_policy::grow:
+                return grow_slots(q_data, count) ? data_pit_result::success : data_pit_result::queue_is_full;
+            default:
+                return data_pit_result::queue_is_full;
+            }
+
+            // Wait without the mutex, so that the consumers can free slots meanwhile
+            if (count > ring.capacity()) return data_pit_result::queue_is_full;
+            if (expired) return data_pit_result::timeout_expired;
+            if (!deadline.has_value())
+            {
+                auto timeout_ms = q_data.overflow_timeout_ms.load(std::memory_order_relaxed);
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            }
+            lock.unlock();
+            expired = !space.wait_until(sequence, *deadline);
+            lock.lock();
+
+            // The type of the queue may have changed while waiting
+            if (!bind_queue_type<T>(q_data, true)) return data_pit_result::type_mismatch;
+        }
+    }
+
+    /**
+     * @brief               This function is used to drop the oldest data of a full queue to make room for new data
+     * @param   q_data      The data of the queue, whose mutex must be locked
+     * @param   count       The number of data to make room for
+     * @return              True if there is room for the data, false if some data to be dropped are viewed
+     */
+    inline bool overwrite_slots(data_t& q_data, size_t count)
+    {
+        auto& ring = queue(q_data);
+        if (count > ring.capacity()) return false;
+
+        // The data viewed by the consumers or pinned by a snapshot cannot be dropped
+        auto retained = ring.head() + count - ring.capacity();
+        if (pinned_data(q_data) < retained) return false;
+        for (auto& c_data : queue_consumers(q_data))
+        {
+            if (consumer_hold(*c_data).load(std::memory_order_acquire) < retained) return false;
+        }
+
+        q_data.dropped.fetch_add(retained - ring.tail(), std::memory_order_relaxed);
+        ring.discard_until(retained);
+        return true;
+    }
+
+    /**
+     * @brief               This function is used to grow a full queue to make room for new data
+     * @param   q_data      The data of the queue, whose mutex must be locked
+     * @param   count       The number of data to make room for
+     * @return              True if there is room for the data, false if some data are viewed or pinned
+     */
+    inline bool grow_slots(data_t& q_data, size_t count)
+    {
+        // The data viewed by the consumers or pinned by a snapshot cannot be moved to the new storage
+        if (!q_data.snapshots.empty()) return false;
+        for (auto& c_data : queue_consumers(q_data))
+        {
+            if (consumer_hold(*c_data).load(std::memory_order_acquire) != no_hold) return false;
+        }
+
+        auto& ring = queue(q_data);
+        ring.resize(std::max(ring.capacity() * 2, ring.size() + count));
+        return true;
+    }
+
+    /**
+     * @brief               This function is used to wake up the producers waiting for room in a queue
+     * @param   q_data      The data of the queue
+     */
+    inline void notify_space(data_t& q_data)
+    {
+        // The producer of a mapped queue may be in another process, whose overflow policy is not known
+        if (queue_overflow(q_data).load(std::memory_order_relaxed) == data_pit_overflow_policy::block ||
+            q_data.mapping != nullptr)
+        {
+            queue_space(q_data).notify_all();
+        }
+    }
+
+    /**
+     * @brief               This function is used to free the slots that all the consumers of a queue have read
+     * @param   q_data      The data of the queue
+     * @param   count       The number of slots needed
+     * @return              True if at least count slots are free, false otherwise
+     * @note                The mutex of the queue must be locked
+     */
+    inline bool reclaim_slots(data_t& q_data, size_t count)
+    {
+        // The consumers of a mapped queue retain their data as well, in every process and even if not registered
+        auto& consumers = queue_consumers(q_data);
+        auto cursor = q_data.mapping != nullptr ? q_data.mapping->oldest_cursor(no_hold) : no_hold;
+
+        // A queue without consumers keeps its data for the consumers yet to come, within its retention if any
+        auto& ring = queue(q_data);
+        if (consumers.empty() && cursor == no_hold)
+        {
+            if (q_data.retention_count == std::numeric_limits<size_t>::max() &&
+                q_data.retention_age_ms.load(std::memory_order_relaxed) == 0)
+            {
+                return false;
+            }
+            ring.discard_until(std::min(window_start(q_data), pinned_data(q_data)));
+            return ring.capacity() - ring.size() >= count;
+        }
+
+        // The slowest consumer and the oldest snapshot set the oldest data that must be retained
+        auto oldest = std::min({ring.head(), std::max(oldest_data(q_data), cursor), pinned_data(q_data)});
+        for (auto& c_data : consumers)
+        {
+            oldest = std::min(oldest, retained_data(q_data, *c_data));
+        }
+
+        ring.discard_until(oldest);
+        return ring.capacity() - ring.size() >= count;
+    }
+
+    /**
+     * @brief               This function is used to discard all the data of a queue
+     * @param   q_data      The data of the queue
+     * @note                The mutex of the queue must be locked
+     */
+    inline void discard_all_data(data_t& q_data)
+    {
+        // Consumers skip the data older than the floor
+        queue_floor(q_data).store(queue(q_data).head(), std::memory_order_release);
+        notify_space(q_data);
+
+        // The consumers of a single_producer queue may be reading, so its slots are reclaimed later
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer) return;
+
+        // The data viewed by the consumers or pinned by a snapshot are retained until released
+        auto oldest = std::min(queue(q_data).head(), pinned_data(q_data));
+        for (auto& c_data : queue_consumers(q_data))
+        {
+            oldest = std::min(oldest, consumer_hold(*c_data).load(std::memory_order_acquire));
+        }
+        queue(q_data).discard_until(oldest);
+    }
+
+    /**
+     * @brief               This function is used to get the position of the oldest data a consumer can read
+     * @param   q_data      The data of the queue
+     * @return              The position of the oldest data
+     */
+    inline index_t oldest_data(data_t& q_data)
+    {
+        return std::max(queue(q_data).tail(), queue_floor(q_data).load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief               This function is used to get the position of the oldest data offered to the consumers
+     *                      yet to come, which is the oldest data a seek can reach
+     * @param   q_data      The data of the queue
+     * @return              The position of the oldest data within the retention of the queue
+     * @note                The mutex of the queue must be locked
+     */
+    inline index_t window_start(data_t& q_data)
+    {
+        auto oldest = oldest_data(q_data);
+        auto head = queue(q_data).head();
+
+        // Skip the data beyond the number retained
+        if (head - oldest > q_data.retention_count) oldest = head - q_data.retention_count;
+
+        // Skip the data produced before the age retained, at the resolution of the marks
+        auto age_ms = q_data.retention_age_ms.load(std::memory_order_relaxed);
+        if (age_ms != 0)
+        {
+            auto expiry = std::chrono::steady_clock::now() - std::chrono::milliseconds(age_ms);
+            auto& marks = q_data.marks;
+            auto mark = std::partition_point(marks.begin(), marks.end(),
+                                             [&](const auto& m) { return m.second < expiry; });
+            oldest = std::max(oldest, mark != marks.end() ? mark->first : head);
+        }
+        return oldest;
+    }
+
+    /**
+     * @brief               This function is used to record when the next data of a queue are produced
+     * @param   q_data      The data of the queue
+     * @param   position    The position of the next data
+     * @note                The mutex of the queue must be locked
+     */
+    inline void record_mark(data_t& q_data, index_t position)
+    {
+        // The data produced within a millisecond share a mark
+        auto now = std::chrono::steady_clock::now();
+        auto& marks = q_data.marks;
+        if (marks.empty() || now - marks.back().second >= std::chrono::milliseconds(1))
+        {
+            marks.emplace_back(position, now);
+        }
+
+        // The marks of the reclaimed data are no longer needed, but the last one
+        while (marks.size() > 1 && marks[1].first <= queue(q_data).tail())
+        {
+            marks.pop_front();
+        }
+    }
+
+    /**
+     * @brief               This function is used to get the position of the next data a consumer will consume
+     * @param   q_data      The data of the queue of the consumer
+     * @param   c_data      The data of the consumer
+     * @return              The position of the next data of the consumer
+     */
+    inline index_t consumer_position(data_t& q_data, consumer_data_t& c_data)
+    {
+        return std::max({consumer_index(c_data).load(std::memory_order_acquire),
+                         consumer_seek(c_data).load(std::memory_order_acquire), oldest_data(q_data)});
+    }
+
+    /**
+     * @brief               This function is used to move a consumer to a position in its queue
+     * @param   q_data      The data of the queue of the consumer
+     * @param   c_data      The data of the consumer
+     * @param   position    The position of the next data to be consumed
+     * @note                The mutex of the queue must be locked
+     */
+    inline void move_consumer(data_t& q_data, consumer_data_t& c_data, index_t position)
+    {
+        // A consumer of a single_producer queue without a group may be reading the data it would skip, so it moves
+        // forward itself, as it skips the cleared data
+        auto& index = consumer_index(c_data);
+        auto& seek = consumer_seek(c_data);
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer && consumer_group(c_data) == nullptr &&
+            position > index.load(std::memory_order_acquire))
+        {
+            seek.store(position, std::memory_order_release);
+            return;
+        }
+
+        // Moving backwards is safe even while the consumer is reading, since no slot is reclaimed meanwhile,
+        // and the other consumers read under the mutex or claim the data they read
+        seek.store(0, std::memory_order_relaxed);
+        index.store(position, std::memory_order_release);
+    }
+
+    /**
+     * @brief               This function is used to check if a consumer has data available
+     * @param   q_data      The data of the queue of the consumer
+     * @param   c_data      The data of the consumer
+     * @return              True if the consumer has data available
+     */
+    inline bool has_data(data_t& q_data, consumer_data_t& c_data)
+    {
+        // The ring buffer of a single_producer queue is only replaced before its type is known
+        if (queue_mode(q_data) == data_pit_queue_mode::single_producer)
+        {
+            return queue_type(q_data).load(std::memory_order_acquire) != nullptr && data_available(q_data, c_data);
+        }
+
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        return data_available(q_data, c_data);
+    }
+
+    /**
+     * @brief               This function is used to check if a consumer has data available
+     * @param   q_data      The data of the queue of the consumer, whose ring buffer cannot be replaced meanwhile
+     * @param   c_data      The data of the consumer
+     * @return              True if the consumer has data available
+     */
+    inline bool data_available(data_t& q_data, consumer_data_t& c_data)
+    {
+        return consumer_position(q_data, c_data) < queue(q_data).head();
+    }
+
+    /**
+     * @brief               This function is used to get an awaitable consuming data from a coroutine
+     * @param   consumer_id The ID of the consumer
+     * @param   executor    The function resuming the coroutine
+     * @param   consume     The function consuming the data without blocking, given the queue and the consumer,
+     *                      which are nullptr if the consumer does not exist
+     * @return              The awaitable
+     */
+    template<typename Executor, typename Consume>
+    data_pit_awaitable<Consume, Executor> async_awaitable(unsigned int consumer_id, Executor executor,
+                                                          Consume consume)
+    {
+        // The consumer stays alive while the coroutine waits, even if it is unregistered meanwhile
+        auto consumer = m_consumers_data.find(consumer_id);
+        std::shared_ptr<consumer_data_t> c_data = consumer.has_value() ? consumer.value() : nullptr;
+        auto q_data = c_data != nullptr ? &queue_data(consumer_queue(*c_data)) : nullptr;
+        return data_pit_awaitable<Consume, Executor>(*this, std::move(c_data), q_data, std::move(consume),
+                                                     std::move(executor));
+    }
+
+    /**
+     * @brief               This function is used to suspend a coroutine until its consumer has data available
+     * @param   q_data      The data of the queue of the consumer
+     * @param   waiter      The waiter of the coroutine
+     * @return              True if the coroutine is suspended, false if it can consume right away
+     */
+    inline bool suspend_async(data_t& q_data, async_waiter_t& waiter)
+    {
+        std::unique_lock queue_lock(queue_mutex(q_data));
+
+        // Add the waiter before checking for data, so that the producers find it if there are none
+        auto& waiters = q_data.async_waiters;
+        waiter.next = waiters.load(std::memory_order_relaxed);
+        waiters.store(&waiter, std::memory_order_seq_cst);
+        if (consumer_registered(*waiter.consumer).load(std::memory_order_acquire) &&
+            !data_available(q_data, *waiter.consumer))
+        {
+            return true;
+        }
+
+        waiters.store(waiter.next, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief               This function is used to forget a coroutine destroyed while suspended
+     * @param   q_data      The data of the queue of the consumer
+     * @param   waiter      The waiter of the coroutine, which is unlinked if the producers have not resumed it yet
+     */
+    inline void cancel_async(data_t& q_data, async_waiter_t& waiter)
+    {
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        auto& waiters = q_data.async_waiters;
+        auto current = waiters.load(std::memory_order_relaxed);
+        if (current == &waiter)
+        {
+            waiters.store(waiter.next, std::memory_order_relaxed);
+            return;
+        }
+
+        for (; current != nullptr; current = current->next)
+        {
+            if (current->next == &waiter)
+            {
+                current->next = waiter.next;
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief               This function is used to resume the coroutines whose consumer has data available
+     * @param   q_data      The data of the queue
+     * @param   consumer    The consumer whose coroutines are resumed whether it has data or not, if any
+     */
+    inline void resume_async_waiters(data_t& q_data, consumer_data_t* consumer = nullptr)
+    {
+        auto& waiters = q_data.async_waiters;
+        if (waiters.load(std::memory_order_seq_cst) == nullptr) return;
+
+        // Split the waiters under the mutex, then resume the ready ones without it, since they consume
+        async_waiter_t* ready = nullptr;
+        {
+            std::unique_lock queue_lock(queue_mutex(q_data));
+            async_waiter_t* waiting = nullptr;
+            for (auto waiter = waiters.load(std::memory_order_relaxed); waiter != nullptr;)
+            {
+                auto next = waiter->next;
+                auto& list = waiter->consumer == consumer || data_available(q_data, *waiter->consumer) ? ready
+                                                                                                        : waiting;
+                waiter->next = list;
+                list = waiter;
+                waiter = next;
+            }
+            waiters.store(waiting, std::memory_order_relaxed);
+        }
+
+        // A resumed coroutine may destroy its waiter
+        while (ready != nullptr)
+        {
+            auto next = ready->next;
+            ready->schedule(*ready);
+            ready = next;
+        }
+    }
+
+    /**
+     * @brief               This function is used to lock the mutex of a queue on the paths of producing and consuming
+     * @param   q_data      The data of the queue
+     * @return              The lock of the mutex
+     * @note                The time spent waiting for the mutex is recorded in the statistics of the queue
+     */
+    inline std::unique_lock<std::mutex> lock_queue(data_t& q_data)
+    {
+#if DATA_PIT_STATS
+        // Only read the clock when the mutex is found locked
+        std::unique_lock lock(queue_mutex(q_data), std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            q_data.stats.record_lock_wait(std::chrono::steady_clock::now() - start);
+        }
+        return lock;
+#else
+        return std::unique_lock(queue_mutex(q_data));
+#endif
+    }
+
+#if DATA_PIT_STATS
+    /**
+     * @brief               This function is used to count the failure of a call in the statistics of a queue
+     * @param   q_data      The data of the queue
+     * @param   result      The result of the call
+     */
+    inline void record_result(data_t& q_data, data_pit_result result)
+    {
+        switch (result)
+        {
+            case data_pit_result::queue_is_full:
+            case data_pit_result::data_dropped:
+                q_data.stats.record_full();
+                break;
+            case data_pit_result::timeout_expired:
+                q_data.stats.record_timeout();
+                break;
+            case data_pit_result::type_mismatch:
+                q_data.stats.record_type_mismatch();
+                break;
+            default:
+                break;
+        }
+    }
+#endif
+
+    /**
+     * @brief               This function is used to signal the file descriptors of the consumers of a queue which
+     *                      have data available, if any
+     * @param   q_data      The data of the queue
+     */
+    inline void signal_consumer_fds(data_t& q_data)
+    {
+        if (q_data.fd_watchers.load(std::memory_order_seq_cst) == 0) return;
+
+        std::unique_lock queue_lock(queue_mutex(q_data));
+        for (auto& c_data : queue_consumers(q_data))
+        {
+            auto& readiness = consumer_readiness(*c_data);
+            if (readiness.is_open() && data_available(q_data, *c_data)) readiness.signal();
+        }
+    }
+
+    /**
+     * @brief               This function is used to wake up the threads polling consumers, if any
+     */
+    inline void notify_pollers()
+    {
+        if (m_pollers.load(std::memory_order_seq_cst) != 0) m_poll_signal.notify_all();
+    }
+
+    /**
+     * @brief               This function is used to get the data of a queue with a specific id
+     * @param   queue_id    The id of the queue
+     * @return              The data of the queue, which is initialized if the queue does not exist
+     * @note                Queues are never removed, so the data stay valid for as long as the data_pit exists
+     */
+    inline data_t& queue_data(int queue_id)
+    {
+        return m_queues_data.find_or_insert(queue_id, [this](data_t& q_data) { init_queue(q_data, m_queue_defaults); });
+    }
+
+    /**
+     * @brief               This function is used to get the ring buffer of a queue
+     * @param   q_data      The data of the queue
+     * @return              The ring buffer of the queue
+     */
+    inline ring_buffer_base& queue(data_t& q_data)
+    {
+        return *q_data.ring;
+    }
+
+    /**
+     * @brief               This function is used to get the typed ring buffer of a queue
+     * @tparam  T           The type of the data, which must be the type of the queue
+     * @param   q_data      The data of the queue
+     * @return              The typed ring buffer of the queue
+     */
+    template<typename T>
+    inline ring_buffer<T>& typed_queue(data_t& q_data)
+    {
+        return static_cast<ring_buffer<T>&>(*q_data.ring);
+    }
+
+    /**
+     * @brief               This function is used to get the type of the data in a queue
+     * @param   q_data      The data of the queue
+     * @return              The type of the data in the queue, or nullptr if it is not known yet
+     */
+    inline std::atomic<const std::type_info*>& queue_type(data_t& q_data)
+    {
+        return q_data.type;
+    }
+
+    /**
+     * @brief               This function is used to get the mutex for a queue
+     * @param   q_data      The data of the queue
+     * @return              The mutex for the queue
+     */
+    inline std::mutex& queue_mutex(data_t& q_data)
+    {
+        return q_data.mutex;
+    }
+
+    /**
+     * @brief               This function is used to get the sequence the consumers of a queue wait on
+     * @param   q_data      The data of the queue
+     * @return              The sequence, which advances every time data are produced in the queue
+     */
+    inline wait_sequence& queue_signal(data_t& q_data)
+    {
+        return *q_data.signal_ref;
+    }
+
+    /**
+     * @brief               This function is used to get the sequence the producers of a full queue wait on
+     * @param   q_data      The data of the queue
+     * @return              The sequence, which advances every time the consumers of the queue may free slots
+     */
+    inline wait_sequence& queue_space(data_t& q_data)
+    {
+        return *q_data.space_ref;
+    }
+
+    /**
+     * @brief               This function is used to get the overflow policy of a queue
+     * @param   q_data      The data of the queue
+     * @return              The overflow policy of the queue
+     */
+    inline std::atomic<data_pit_overflow_policy>& queue_overflow(data_t& q_data)
+    {
+        return q_data.overflow;
+    }
+
+    /**
+     * @brief               This function is used to get the consumers registered to a queue
+     * @param   q_data      The data of the queue
+     * @return              The consumers of the queue
+     */
+    inline std::vector<std::shared_ptr<consumer_data_t>>& queue_consumers(data_t& q_data)
+    {
+        return q_data.consumers;
+    }
+
+    /**
+     * @brief               This function is used to know if the type of a queue can no longer change
+     * @param   q_data      The data of the queue
+     * @return              True if a channel has been created for the queue or if it is a single_producer queue
+     */
+    inline bool& queue_pinned(data_t& q_data)
+    {
+        return q_data.pinned;
+    }
+
+    /**
+     * @brief               This function is used to get the mode of a queue
+     * @param   q_data      The data of the queue
+     * @return              The mode of the queue
+     */
+    inline data_pit_queue_mode& queue_mode(data_t& q_data)
+    {
+        return q_data.mode;
+    }
+
+    /**
+     * @brief               This function is used to get the position before which the data of a queue are cleared
+     * @param   q_data      The data of the queue
+     * @return              The position of the first data not cleared
+     */
+    inline std::atomic<index_t>& queue_floor(data_t& q_data)
+    {
+        return *q_data.floor_ref;
+    }
+
+    /**
+     * @brief               This function is used to get the id of the queue of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The id of the queue
+     */
+    inline int consumer_queue(consumer_data_t& c_data)
+    {
+        return c_data.queue_id;
+    }
+
+    /**
+     * @brief               This function is used to get the index of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The index of the consumer, which is the index of its group if it has one
+     */
+    inline std::atomic<index_t>& consumer_index(consumer_data_t& c_data)
+    {
+        auto& group = consumer_group(c_data);
+        return group != nullptr ? std::get<1>(*group) : *c_data.cursor;
+    }
+
+    /**
+     * @brief               This function is used to get the last error of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The last error of the consumer
+     */
+    inline std::atomic<data_pit_result>& data_pit_error(consumer_data_t& c_data)
+    {
+        return c_data.error;
+    }
+
+    /**
+     * @brief               This function is used to get the position of the data viewed by a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The position of the data viewed by the consumer, or no_hold
+     */
+    inline std::atomic<index_t>& consumer_hold(consumer_data_t& c_data)
+    {
+        return c_data.hold;
+    }
+
+    /**
+     * @brief               This function is used to get the wait policy of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The wait policy of the consumer
+     */
+    inline std::atomic<data_pit_wait_policy>& consumer_policy(consumer_data_t& c_data)
+    {
+        return c_data.policy;
+    }
+
+    /**
+     * @brief               This function is used to get the group of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The group of the consumer, or nullptr if it has none
+     */
+    inline const std::shared_ptr<consumer_group_t>& consumer_group(consumer_data_t& c_data)
+    {
+        return c_data.group;
+    }
+
+    /**
+     * @brief               This function is used to get the position of the data claimed by a consumer of a group
+     *                      while it reads them
+     * @param   c_data      The data of the consumer
+     * @return              The position of the data claimed by the consumer, or no_hold
+     */
+    inline std::atomic<index_t>& consumer_hazard(consumer_data_t& c_data)
+    {
+        return c_data.hazard;
+    }
+
+    /**
+     * @brief               This function is used to get the position a seek moved a consumer forward to
+     * @param   c_data      The data of the consumer
+     * @return              The position sought, or 0
+     */
+    inline std::atomic<index_t>& consumer_seek(consumer_data_t& c_data)
+    {
+        return c_data.seek;
+    }
+
+    /**
+     * @brief               This function is used to know whether a consumer is still registered
+     * @param   c_data      The data of the consumer
+     * @return              True until the consumer is unregistered
+     */
+    inline std::atomic<bool>& consumer_registered(consumer_data_t& c_data)
+    {
+        return c_data.registered;
+    }
+
+    /**
+     * @brief               This function is used to get the file descriptor of a consumer
+     * @param   c_data      The data of the consumer
+     * @return              The file descriptor readable while the consumer has data available
+     */
+    inline event_fd& consumer_readiness(consumer_data_t& c_data)
+    {
+        return c_data.readiness;
+    }
+
+    /**
+     * @brief This function is used to register a new consumer ID
+     * @return The registered consumer ID or 0 if the maximum number of consumers has been reached
+     */
+    unsigned int register_id()
+    {
+        // Lock the mutex to ensure thread safety
+        std::lock_guard lock(m_mtx);
+
+        unsigned int consumer_id;
+
+        // Check if there are any released IDs available
+        if (!released_ids.empty())
+        {
+            // If there are, use the first one
+            consumer_id = released_ids.front();
+            released_ids.pop();
+        }
+        else
+        {
+            // If there are no released IDs available, check if the next consumer ID has reached its maximum value
+            if(m_next_consumer_id == std::numeric_limits<unsigned int>::max())
+            {
+                // If it has, return 0
+                return 0;
+            }
+
+            // If the next consumer ID has not reached its maximum value, use it and increment it
+            consumer_id = m_next_consumer_id++;
+        }
+
+        // Return the registered consumer ID
+        return consumer_id;
+    }
+
+    /**
+     * @brief               This function is used to unregister a specific consumer ID
+     * @param   consumer_id The ID of the consumer to be unregistered
+     */
+    void unregister_id(unsigned int consumer_id)
+    {
+        std::lock_guard lock(m_mtx);
+        released_ids.push(consumer_id);
+    }
+
+    // The memory resource of the queues created without their own
+    std::pmr::memory_resource* m_resource;
+    // The options of the queues used before being created
+    data_pit_queue_options m_queue_defaults;
+    // Data structure to store the data for each queue
+    // The queues are looked up by every call but rarely created, so the lookups take no lock
+    rcu_hash_map<queue_id_t, data_t> m_queues_data;
+    // Data structure to store the data for each consumer
+    // The consumers are only copied out of the map, so its entries can be stored in place
+    concurrent_hash_map<consumer_id_t, std::shared_ptr<consumer_data_t>, DATA_PIT_MAP_SHARDS,
+                        flat_hash_map<consumer_id_t, std::shared_ptr<consumer_data_t>>> m_consumers_data;
+    // Mutex for the consumer IDs
+    std::mutex m_mtx;
+    // Next consumer ID
+    unsigned int m_next_consumer_id;
+    // Queue of released IDs
+    std::queue<unsigned int> released_ids;
+    // The number of threads polling consumers
+    alignas(DATA_PIT_CACHE_LINE_SIZE) std::atomic<uint32_t> m_pollers{0};
+    // The sequence the polling threads wait on, which advances when data are produced while they poll
+    alignas(DATA_PIT_CACHE_LINE_SIZE) wait_sequence m_poll_signal;
+};
+
+/**
+ * @brief data_pit_channel class
+ *
+ * A statically typed handle to a queue of a data_pit. The type of the queue is checked once when the channel
+ * is created, then data are produced and consumed straight from the contiguous storage of the queue.
+ *
+ * @tparam T The type of the data of the queue
+ */
+template<typename T>
+class data_pit_channel
+{
+public:
+    /**
+     * @brief               This function is used to produce data in the queue of the channel
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     */
+    data_pit_result produce(const T& data)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, false, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(data);
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce data in the queue of the channel, moving it into the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                The data is left untouched if it is not produced
+     */
+    data_pit_result produce(T&& data)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, false, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::move(data));
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce data in the queue of the channel, constructing it in place
+     * @param   args        The arguments forwarded to the constructor of the data
+     * @return              The result of the operation
+     */
+    template<typename... Args>
+    data_pit_result emplace(Args&&... args)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, false, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::forward<Args>(args)...);
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce a batch of data in the queue of the channel
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                Either the whole batch is produced or none of it
+     */
+    data_pit_result produce_bulk(std::span<const T> data)
+    {
+        return m_pit->template produce_data<T>(*m_data, data.size(), false, [&](ring_buffer<T>& ring)
+        {
+            ring.append(data.begin(), data.end());
+        });
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the channel
+     * @param   consumer_id The ID of the consumer, which must be registered to the queue of the channel
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    std::optional<T> consume(unsigned int consumer_id, bool blocking = false,
+                             uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // Check if the consumer is registered to the queue of the channel
+        auto consumer = find_consumer(consumer_id);
+        if (consumer == nullptr) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *consumer, blocking, timeout_ms, false, 1,
+                                        [&](ring_buffer<T>& ring, uint64_t position, size_t)
+                                        {
+                                            data.emplace(ring.at(position));
+                                        });
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the channel, moving it out of
+     *                      the queue if no other consumer needs it
+     * @param   consumer_id The ID of the consumer, which must be registered to the queue of the channel
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    std::optional<T> consume_move(unsigned int consumer_id, bool blocking = false,
+                                  uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // Check if the consumer is registered to the queue of the channel
+        auto consumer = find_consumer(consumer_id);
+        if (consumer == nullptr) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *consumer, blocking, timeout_ms, false, 1,
+                                        m_pit->template move_reader<T>(*m_data, *consumer, data));
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the channel without copying it
+     * @param   consumer_id The ID of the consumer, which must be registered to the queue of the channel
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              A view of the consumed data, or std::nullopt if no data are available
+     * @note                The view is valid until it is released, or the consumer consumes again, is unregistered,
+     *                      or the size of the queue is set
+     */
+    std::optional<data_pit_view<T>> consume_view(unsigned int consumer_id, bool blocking = false,
+                                                 uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // Check if the consumer is registered to the queue of the channel
+        auto consumer = find_consumer(consumer_id);
+        if (consumer == nullptr) return std::nullopt;
+
+        // Fetch the data from the queue, holding its slot
+        std::optional<data_pit_view<T>> view;
+        m_pit->template consume_data<T>(*m_data, *consumer, blocking, timeout_ms, false, 1,
+                                        m_pit->template view_reader<T>(consumer, view));
+        return view;
+    }
+
+    /**
+     * @brief               This function is used to consume a batch of data from the queue of the channel
+     * @param   consumer_id The ID of the consumer, which must be registered to the queue of the channel
+     * @param   out         The destination of the consumed data
+     * @param   max_n       The maximum number of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The number of data consumed, 0 if no data are available
+     */
+    template<typename OutputIt>
+    size_t consume_bulk(unsigned int consumer_id, OutputIt out, size_t max_n, bool blocking = false,
+                        uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // Check if the consumer is registered to the queue of the channel
+        auto consumer = find_consumer(consumer_id);
+        if (consumer == nullptr || max_n == 0) return 0;
+
+        // Fetch the data from the queue
+        return m_pit->template consume_data<T>(*m_data, *consumer, blocking, timeout_ms, false, max_n,
+                                               [&](ring_buffer<T>& ring, uint64_t position, size_t count)
+                                               {
+                                                   out = ring.copy(position, count, out);
+                                               });
+    }
+
+    /**
+     * @brief               This function is used to get the id of the queue of the channel
+     * @return              The id of the queue
+     */
+    int queue_id() const
+    {
+        return m_queue_id;
+    }
+
+private:
+    friend class data_pit;
+    template<typename...>
+    friend class data_pit_static;
+
+    /**
+     * @brief               This function is used to find a consumer registered to the queue of the channel
+     * @param   consumer_id The ID of the consumer
+     * @return              The consumer, or nullptr if it is not registered to the queue of the channel
+     */
+    std::shared_ptr<data_pit::consumer_data_t> find_consumer(unsigned int consumer_id)
+    {
+        auto consumer = m_pit->m_consumers_data.find(consumer_id);
+        if (!consumer.has_value() || m_pit->consumer_queue(*consumer.value()) != m_queue_id) return nullptr;
+        return consumer.value();
+    }
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit owning the queue
+     * @param   queue_id    The id of the queue
+     * @param   q_data      The data of the queue
+     */
+    data_pit_channel(data_pit& pit, int queue_id, data_pit::data_t& q_data)
+        : m_pit(&pit), m_queue_id(queue_id), m_data(&q_data) {}
+
+    // The data_pit owning the queue
+    data_pit* m_pit;
+    // The id of the queue
+    int m_queue_id;
+    // The data of the queue, which lives as long as the data_pit
+    data_pit::data_t* m_data;
+};
+
+/**
+ * @brief data_pit_consumer_handle class
+ *
+ * A handle to a registered consumer, which keeps direct references to the consumer and to its queue so that
+ * consuming through it does not look either of them up.
+ */
+class data_pit_consumer_handle
+{
+public:
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer
+     * @tparam  T           The type of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    template<typename T>
+    std::optional<T> consume(bool blocking = false, uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, true, 1,
+                                        [&](ring_buffer<T>& ring, uint64_t position, size_t)
+                                        {
+                                            data.emplace(ring.at(position));
+                                        });
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer, moving it out of
+     *                      the queue if no other consumer needs it
+     * @tparam  T           The type of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    template<typename T>
+    std::optional<T> consume_move(bool blocking = false, uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, true, 1,
+                                        m_pit->template move_reader<T>(*m_data, *m_consumer, data));
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer without copying it
+     * @tparam  T           The type of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              A view of the consumed data, or std::nullopt if no data are available
+     * @note                The view is valid until it is released, or the consumer consumes again, is unregistered,
+     *                      or the size of the queue is set
+     */
+    template<typename T>
+    std::optional<data_pit_view<T>> consume_view(bool blocking = false,
+                                                 uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue, holding its slot
+        std::optional<data_pit_view<T>> view;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, true, 1,
+                                        m_pit->template view_reader<T>(m_consumer, view));
+        return view;
+    }
+
+    /**
+     * @brief               This function is used to consume a batch of data from the queue of the consumer
+     * @tparam  T           The type of data to be consumed
+     * @param   out         The destination of the consumed data
+     * @param   max_n       The maximum number of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The number of data consumed, 0 if no data are available
+     */
+    template<typename T, typename OutputIt>
+    size_t consume_bulk(OutputIt out, size_t max_n, bool blocking = false,
+                        uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered() || max_n == 0) return 0;
+
+        // Fetch the data from the queue
+        return m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, true, max_n,
+                                               [&](ring_buffer<T>& ring, uint64_t position, size_t count)
+                                               {
+                                                   out = ring.copy(position, count, out);
+                                               });
+    }
+
+    /**
+     * @brief               This function is used to get the last error of the consumer
+     * @return              The last error of the consumer
+     */
+    data_pit_result get_last_error() const
+    {
+        return m_pit->data_pit_error(*m_consumer).load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief               This function is used to get the id of the consumer
+     * @return              The id of the consumer
+     */
+    unsigned int consumer_id() const
+    {
+        return m_consumer_id;
+    }
+
+private:
+    friend class data_pit;
+
+    /**
+     * @brief               This function is used to check that the consumer is still registered
+     * @return              True if the consumer is registered, otherwise the error of the consumer is set
+     */
+    bool registered()
+    {
+        if (m_pit->consumer_registered(*m_consumer).load(std::memory_order_acquire)) return true;
+        m_pit->data_pit_error(*m_consumer).store(data_pit_result::consumer_not_found, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit owning the consumer
+     * @param   consumer_id The id of the consumer
+     * @param   consumer    The data of the consumer
+     * @param   q_data      The data of the queue of the consumer
+     */
+    data_pit_consumer_handle(data_pit& pit, unsigned int consumer_id,
+                             std::shared_ptr<data_pit::consumer_data_t> consumer, data_pit::data_t& q_data)
+        : m_pit(&pit), m_consumer_id(consumer_id), m_consumer(std::move(consumer)), m_data(&q_data) {}
+
+    // The data_pit owning the consumer
+    data_pit* m_pit;
+    // The id of the consumer
+    unsigned int m_consumer_id;
+    // The data of the consumer, which lives as long as the handle
+    std::shared_ptr<data_pit::consumer_data_t> m_consumer;
+    // The data of the queue of the consumer, which lives as long as the data_pit
+    data_pit::data_t* m_data;
+};
+
+/**
+ * @brief data_pit_producer_handle class
+ *
+ * A handle to a queue, which keeps a direct reference to the queue so that producing through it does not look
+ * the queue up. Unlike a channel, the type of the data is checked on every call, so the queue can change type.
+ */
+class data_pit_producer_handle
+{
+public:
+    /**
+     * @brief               This function is used to produce data in the queue of the handle
+     * @tparam  T           The type of data to be produced
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     */
+    template<typename T>
+    data_pit_result produce(const T& data)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, true, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(data);
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce data in the queue of the handle, moving it into the queue
+     * @tparam  T           The type of data to be produced
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                The data is left untouched if it is not produced
+     */
+    template<typename T> requires std::is_same_v<T, std::remove_cvref_t<T>>
+    data_pit_result produce(T&& data)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, true, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::move(data));
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce data in the queue of the handle, constructing it in place
+     * @tparam  T           The type of data to be produced
+     * @param   args        The arguments forwarded to the constructor of the data
+     * @return              The result of the operation
+     */
+    template<typename T, typename... Args>
+    data_pit_result emplace(Args&&... args)
+    {
+        return m_pit->template produce_data<T>(*m_data, 1, true, [&](ring_buffer<T>& ring)
+        {
+            ring.emplace_back(std::forward<Args>(args)...);
+        });
+    }
+
+    /**
+     * @brief               This function is used to produce a batch of data in the queue of the handle
+     * @tparam  T           The type of data to be produced
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                Either the whole batch is produced or none of it
+     */
+    template<typename T>
+    data_pit_result produce_bulk(std::span<const T> data)
+    {
+        return m_pit->template produce_data<T>(*m_data, data.size(), true, [&](ring_buffer<T>& ring)
+        {
+            ring.append(data.begin(), data.end());
+        });
+    }
+
+    /**
+     * @brief               This function is used to get the id of the queue of the handle
+     * @return              The id of the queue
+     */
+    int queue_id() const
+    {
+        return m_queue_id;
+    }
+
+private:
+    friend class data_pit;
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit owning the queue
+     * @param   queue_id    The id of the queue
+     * @param   q_data      The data of the queue
+     */
+    data_pit_producer_handle(data_pit& pit, int queue_id, data_pit::data_t& q_data)
+        : m_pit(&pit), m_queue_id(queue_id), m_data(&q_data) {}
+
+    // The data_pit owning the queue
+    data_pit* m_pit;
+    // The id of the queue
+    int m_queue_id;
+    // The data of the queue, which lives as long as the data_pit
+    data_pit::data_t* m_data;
+};
+
+inline std::optional<data_pit_consumer_handle> data_pit::consumer_handle(unsigned int consumer_id)
+{
+    // Check if consumer_id exists
+    auto consumer = m_consumers_data.find(consumer_id);
+    if (!consumer.has_value()) return std::nullopt;
+
+    auto& q_data = queue_data(consumer_queue(*consumer.value()));
+    return data_pit_consumer_handle(*this, consumer_id, consumer.value(), q_data);
+}
+
+inline data_pit_producer_handle data_pit::producer_handle(int queue_id)
+{
+    return data_pit_producer_handle(*this, queue_id, queue_data(queue_id));
+}
+
+/**
+ * @brief data_pit_awaitable class
+ *
+ * The result of an asynchronous consume, which suspends the awaiting coroutine until its consumer has data
+ * available, then resumes it on its executor and consumes the data.
+ *
+ * @tparam Consume The function consuming the data without blocking
+ * @tparam Executor The function resuming the coroutine, given its handle
+ */
+template<typename Consume, typename Executor>
+class data_pit_awaitable
+{
+public:
+    data_pit_awaitable(const data_pit_awaitable&) = delete;
+    data_pit_awaitable& operator=(const data_pit_awaitable&) = delete;
+
+    /**
+     * @brief Destructor
+     * @note  A coroutine destroyed while suspended is no longer resumed by the producers, unless they are already
+     *        resuming it on another thread
+     */
+    ~data_pit_awaitable()
+    {
+        if (m_handle) m_pit->cancel_async(*m_data, m_waiter);
+    }
+
+    /**
+     * @brief               This function is used to know if the coroutine can consume without being suspended
+     * @return              True if the consumer has data available or does not exist
+     */
+    bool await_ready()
+    {
+        return m_consumer == nullptr || m_pit->has_data(*m_data, *m_consumer);
+    }
+
+    /**
+     * @brief               This function is used to suspend the coroutine until the consumer has data available
+     * @param   handle      The handle of the coroutine
+     * @return              True if the coroutine is suspended, false if it can consume right away
+     */
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        return m_pit->suspend_async(*m_data, m_waiter);
+    }
+
+    /**
+     * @brief               This function is used to consume the data once the coroutine is resumed
+     * @return              The consumed data
+     */
+    auto await_resume()
+    {
+        // The waiter is no longer linked to the queue
+        m_handle = nullptr;
+        return m_consume(m_data, m_consumer.get());
+    }
+
+private:
+    friend class data_pit;
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit owning the consumer
+     * @param   consumer    The data of the consumer, or nullptr if it does not exist
+     * @param   q_data      The data of the queue of the consumer, or nullptr if it does not exist
+     * @param   consume     The function consuming the data
+     * @param   executor    The function resuming the coroutine
+     */
+    data_pit_awaitable(data_pit& pit, std::shared_ptr<data_pit::consumer_data_t> consumer, data_pit::data_t* q_data,
+                       Consume consume, Executor executor)
+        : m_pit(&pit), m_consumer(std::move(consumer)), m_data(q_data), m_consume(std::move(consume)),
+          m_executor(std::move(executor)), m_waiter{m_consumer.get(), &schedule, this} {}
+
+    /**
+     * @brief               This function is used to resume the coroutine of a waiter on its executor
+     * @param   waiter      The waiter of the coroutine
+     */
+    static void schedule(data_pit::async_waiter_t& waiter)
+    {
+        auto& awaitable = *static_cast<data_pit_awaitable*>(waiter.context);
+        awaitable.m_executor(awaitable.m_handle);
+    }
+
+    // The data_pit owning the consumer
+    data_pit* m_pit;
+    // The data of the consumer, which lives as long as the awaitable
+    std::shared_ptr<data_pit::consumer_data_t> m_consumer;
+    // The data of the queue of the consumer, which lives as long as the data_pit
+    data_pit::data_t* m_data;
+    // The function consuming the data
+    Consume m_consume;
+    // The function resuming the coroutine
+    Executor m_executor;
+    // The waiter of the coroutine, linked to the queue while it is suspended
+    data_pit::async_waiter_t m_waiter;
+    // The handle of the coroutine
+    std::coroutine_handle<> m_handle;
+};
+
+/**
+ * @brief data_pit_view class
+ *
+ * A read-only view of data consumed without copying it. The slot of the data is not reclaimed until the view is
+ * released, or the consumer consumes again, is unregistered, or the size of the queue is set.
+ *
+ * @tparam T The type of the data
+ */
+template<typename T>
+class data_pit_view
+{
+public:
+    data_pit_view(const data_pit_view&) = delete;
+    data_pit_view& operator=(const data_pit_view&) = delete;
+
+    /**
+     * @brief               Move constructor
+     * @param   other       The view to be moved, which no longer holds the data
+     */
+    data_pit_view(data_pit_view&& other) noexcept
+        : m_pit(other.m_pit), m_consumer(std::move(other.m_consumer)), m_data(other.m_data),
+          m_position(other.m_position) {}
+
+    /**
+     * @brief               Move assignment operator
+     * @param   other       The view to be moved, which no longer holds the data
+     * @return              This view
+     */
+    data_pit_view& operator=(data_pit_view&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_pit = other.m_pit;
+            m_consumer = std::move(other.m_consumer);
+            m_data = other.m_data;
+            m_position = other.m_position;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~data_pit_view()
+    {
+        release();
+    }
+
+    /**
+     * @brief               This function is used to access the viewed data
+     * @return              The data
+     */
+    const T& operator*() const { return *m_data; }
+
+    /**
+     * @brief               This function is used to access the members of the viewed data
+     * @return              A pointer to the data
+     */
+    const T* operator->() const { return m_data; }
+
+    /**
+     * @brief               This function is used to release the data, so that its slot can be reclaimed
+     */
+    void release()
+    {
+        if (m_consumer == nullptr) return;
+
+        // The consumer may hold newer data already
+        auto position = m_position;
+        m_pit->consumer_hold(*m_consumer).compare_exchange_strong(position, data_pit::no_hold,
+                                                                  std::memory_order_acq_rel);
+        m_consumer.reset();
+    }
+
+private:
+    friend class data_pit;
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit of the queue
+     * @param   consumer    The consumer holding the data
+     * @param   data        The data
+     * @param   position    The position of the data in the queue
+     */
+    data_pit_view(data_pit& pit, std::shared_ptr<data_pit::consumer_data_t> consumer, const T& data,
+                  uint64_t position)
+        : m_pit(&pit), m_consumer(std::move(consumer)), m_data(&data), m_position(position) {}
+
+    // The data_pit of the queue
+    data_pit* m_pit;
+    // The consumer holding the data
+    std::shared_ptr<data_pit::consumer_data_t> m_consumer;
+    // The data
+    const T* m_data;
+    // The position of the data in the queue
+    uint64_t m_position;
+};
+
+/**
+ * @brief data_pit_snapshot class
+ *
+ * The data of a queue between its oldest data and its head at the time the snapshot was taken. Their slots are
+ * neither reclaimed nor moved until the snapshot is released, while the producers keep appending after them, so the
+ * data are read in place from up to two contiguous blocks, from as many threads as needed.
+ *
+ * @tparam T The type of the data
+ */
+template<typename T>
+class data_pit_snapshot
+{
+public:
+    data_pit_snapshot(const data_pit_snapshot&) = delete;
+    data_pit_snapshot& operator=(const data_pit_snapshot&) = delete;
+
+    /**
+     * @brief               Move constructor
+     * @param   other       The snapshot to be moved, which no longer pins the data
+     */
+    data_pit_snapshot(data_pit_snapshot&& other) noexcept
+        : m_pit(std::exchange(other.m_pit, nullptr)), m_data(other.m_data), m_ring(other.m_ring),
+          m_begin(other.m_begin), m_end(other.m_end) {}
+
+    /**
+     * @brief               Move assignment operator
+     * @param   other       The snapshot to be moved, which no longer pins the data
+     * @return              This snapshot
+     */
+    data_pit_snapshot& operator=(data_pit_snapshot&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_pit = std::exchange(other.m_pit, nullptr);
+            m_data = other.m_data;
+            m_ring = other.m_ring;
+            m_begin = other.m_begin;
+            m_end = other.m_end;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~data_pit_snapshot()
+    {
+        release();
+    }
+
+    /**
+     * @brief               This function is used to get the offset of the first data of the snapshot
+     * @return              The offset, as given by get_queue_offsets
+     */
+    uint64_t begin_offset() const { return m_begin; }
+
+    /**
+     * @brief               This function is used to get the offset past the last data of the snapshot
+     * @return              The offset, which was the head of the queue when the snapshot was taken
+     */
+    uint64_t end_offset() const { return m_end; }
+
+    /**
+     * @brief               This function is used to get the number of data of the snapshot
+     * @return              The number of data
+     */
+    size_t size() const { return static_cast<size_t>(m_end - m_begin); }
+
+    /**
+     * @brief               This function is used to check if the snapshot holds no data
+     * @return              True if the snapshot holds no data, false otherwise
+     */
+    bool empty() const { return m_end == m_begin; }
+
+    /**
+     * @brief               This function is used to access a data of the snapshot
+     * @param   index       The index of the data, from 0 to size() - 1
+     * @return              The data
+     */
+    const T& operator[](size_t index) const { return m_ring->at(m_begin + index); }
+
+    /**
+     * @brief               This function is used to get the contiguous blocks of slots holding the data
+     * @return              The blocks, in the order of the data, the second of which is empty unless the data wrap
+     *                      around the end of the slots
+     */
+    std::array<std::span<const T>, 2> blocks() const
+    {
+        if (empty()) return {};
+        std::span<const T> first = m_ring->block(m_begin, m_end);
+        return {first, std::span<const T>(m_ring->block(m_begin + first.size(), m_end))};
+    }
+
+    /**
+     * @brief               This function is used to call a function on each data, on a number of threads
+     * @param   function    The function called on each data, concurrently from the threads, which must not throw
+     * @param   threads     The number of threads, including the calling one, or 0 for one per hardware thread
+     * @param   grain       The number of contiguous data a thread visits at a time
+     */
+    template<typename Function>
+    void for_each_parallel(Function&& function, unsigned int threads = 0,
+                           size_t grain = DATA_PIT_PARALLEL_GRAIN) const
+    {
+        run_parallel(threads, grain, [&](unsigned int, uint64_t begin, uint64_t end)
+        {
+            visit(begin, end, function);
+        });
+    }
+
+    /**
+     * @brief               This function is used to transform each data and reduce the results, on a number of
+     *                      threads
+     * @tparam  R           The type of the result
+     * @param   init        The initial value of the result
+     * @param   reduce      The function combining two results, which must be associative and commutative
+     * @param   transform   The function giving the result of a data
+     * @param   threads     The number of threads, including the calling one, or 0 for one per hardware thread
+     * @param   grain       The number of contiguous data a thread visits at a time
+     * @return              The reduction of init and of the results of all the data
+     * @note                The functions are called concurrently from the threads, and must not throw
+     */
+    template<typename R, typename Reduce, typename Transform>
+    R transform_reduce(R init, Reduce reduce, Transform transform, unsigned int threads = 0,
+                       size_t grain = DATA_PIT_PARALLEL_GRAIN) const
+    {
+        // Each thread reduces the data it visits on its own cache line
+        struct alignas(DATA_PIT_CACHE_LINE_SIZE) partial_t
+        {
+            std::optional<R> value;
+        };
+        std::vector<partial_t> partials(worker_count(threads, grain));
+
+        run_parallel(threads, grain, [&](unsigned int worker, uint64_t begin, uint64_t end)
+        {
+            auto& partial = partials[worker].value;
+            visit(begin, end, [&](const T& data)
+            {
+                if (partial.has_value()) partial = reduce(std::move(*partial), transform(data));
+                else partial.emplace(transform(data));
+            });
+        });
+
+        for (auto& partial : partials)
+        {
+            if (partial.value.has_value()) init = reduce(std::move(init), std::move(*partial.value));
+        }
+        return init;
+    }
+
+    /**
+     * @brief               This function is used to release the data, so that their slots can be reclaimed
+     */
+    void release()
+    {
+        if (m_pit == nullptr) return;
+
+        // Producers may be waiting for the slots of the data
+        if (!empty())
+        {
+            std::unique_lock queue_lock(m_pit->queue_mutex(*m_data));
+            m_data->snapshots.erase(m_data->snapshots.find(m_begin));
+            m_pit->notify_space(*m_data);
+        }
+        m_pit = nullptr;
+    }
+
+private:
+    friend class data_pit;
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit of the queue
+     * @param   data        The data of the queue, which pins the data of the snapshot
+     * @param   ring        The ring buffer of the queue
+     * @param   begin       The position of the first data
+     * @param   end         The position past the last data
+     */
+    data_pit_snapshot(data_pit& pit, data_pit::data_t& data, ring_buffer<T>& ring, uint64_t begin, uint64_t end)
+        : m_pit(&pit), m_data(&data), m_ring(&ring), m_begin(begin), m_end(end) {}
+
+    /**
+     * @brief               This function is used to call a function on the data of a range, block by block
+     * @param   begin       The position of the first data
+     * @param   end         The position past the last data
+     * @param   function    The function called on each data
+     */
+    template<typename Function>
+    void visit(uint64_t begin, uint64_t end, Function&& function) const
+    {
+        while (begin < end)
+        {
+            std::span<const T> block = m_ring->block(begin, end);
+            for (const auto& data : block)
+            {
+                function(data);
+            }
+            begin += block.size();
+        }
+    }
+
+    /**
+     * @brief               This function is used to get the number of threads visiting the data
+     * @param   threads     The number of threads requested, or 0 for one per hardware thread
+     * @param   grain       The number of contiguous data a thread visits at a time
+     * @return              The number of threads, which is never more than the number of ranges of grain data
+     */
+    unsigned int worker_count(unsigned int threads, size_t grain) const
+    {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        auto ranges = (size() + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1);
+        return static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, ranges)));
+    }
+
+    /**
+     * @brief               This function is used to split the data in ranges visited by a number of threads
+     * @param   threads     The number of threads, including the calling one, or 0 for one per hardware thread
+     * @param   grain       The number of contiguous data of each range
+     * @param   visit_range The function called with the index of the thread and the positions of a range
+     * @note                The threads take the next range as they finish one, so that slower data or cores do not
+     *                      leave the other threads idle
+     */
+    template<typename VisitRange>
+    void run_parallel(unsigned int threads, size_t grain, VisitRange&& visit_range) const
+    {
+        grain = std::max<size_t>(grain, 1);
+        auto workers = worker_count(threads, grain);
+        std::atomic<uint64_t> next{m_begin};
+        auto work = [&](unsigned int worker)
+        {
+            while (true)
+            {
+                auto begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= m_end) return;
+                visit_range(worker, begin, std::min<uint64_t>(begin + grain, m_end));
+            }
+        };
+
+        // The calling thread is the first one
+        std::vector<std::jthread> helpers;
+        helpers.reserve(workers - 1);
+        for (unsigned int worker = 1; worker < workers; ++worker)
+        {
+            helpers.emplace_back(work, worker);
+        }
+        work(0);
+    }
+
+    // The data_pit of the queue, or nullptr once released
+    data_pit* m_pit;
+    // The data of the queue
+    data_pit::data_t* m_data;
+    // The ring buffer of the queue
+    ring_buffer<T>* m_ring;
+    // The position of the first data
+    uint64_t m_begin;
+    // The position past the last data
+    uint64_t m_end;
+};
@@ -0,0 +1,505 @@
+/*
+ *  data_pit_bridge.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "data_pit.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief data_pit_serializer struct
+ *
+ * The default serializer of the data forwarded by a bridge, which copies the bytes of trivially copyable data
+ * and the characters of strings. Other types get their own serializer, either by specializing this template or by
+ * passing another type to the bridge.
+ *
+ * @tparam T The type of the data
+ */
+template<typename T>
+struct data_pit_serializer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "data which are not trivially copyable need a serializer");
+
+    static void serialize(const T& data, std::vector<std::byte>& out)
+    {
+        auto bytes = reinterpret_cast<const std::byte*>(&data);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static std::optional<T> deserialize(std::span<const std::byte> in)
+    {
+        if (in.size() != sizeof(T)) return std::nullopt;
+        T data;
+        std::memcpy(&data, in.data(), sizeof(T));
+        return data;
+    }
+};
+
+template<>
+struct data_pit_serializer<std::string>
+{
+    static void serialize(const std::string& data, std::vector<std::byte>& out)
+    {
+        auto bytes = reinterpret_cast<const std::byte*>(data.data());
+        out.insert(out.end(), bytes, bytes + data.size());
+    }
+
+    static std::optional<std::string> deserialize(std::span<const std::byte> in)
+    {
+        return std::string(reinterpret_cast<const char*>(in.data()), in.size());
+    }
+};
+
+/**
+ * @brief The requirements of a serializer of data of type T: serialize appends the bytes of a data to a buffer,
+ *        and deserialize rebuilds a data from its bytes, or returns std::nullopt if they are not valid.
+ */
+template<typename Serializer, typename T>
+concept data_pit_serializer_for = requires(const T& data, std::vector<std::byte>& out, std::span<const std::byte> in)
+{
+    Serializer::serialize(data, out);
+    { Serializer::deserialize(in) } -> std::same_as<std::optional<T>>;
+};
+
+/**
+ * @brief The header of a batch of data sent by a bridge, followed by every data as its size on 4 bytes then its
+ *        bytes. The integers are sent in the byte order of the host, so both ends must share it.
+ */
+struct data_pit_bridge_frame
+{
+    // The value of the magic number of a frame, "DPIT"
+    static constexpr uint32_t magic_value = 0x54495044u;
+
+    // The magic number
+    uint32_t magic = magic_value;
+    // The number of data
+    uint32_t count = 0;
+    // The number of bytes following the header
+    uint64_t bytes = 0;
+};
+
+/**
+ * @brief data_pit_bridge_sender class
+ *
+ * Tails a queue with a consumer of its own, and sends what it consumes over a connected stream socket, such as a TCP
+ * connection, to a data_pit_bridge_receiver which produces it into a queue of another data_pit, usually on another
+ * host. A batch of data is sent with a single system call.
+ *
+ * The data are consumed before they are sent, so the data of a batch whose sending fails are lost.
+ *
+ * @tparam T The type of the data of the queue
+ * @tparam Serializer The serializer of the data
+ */
+template<typename T, typename Serializer = data_pit_serializer<T>>
+requires data_pit_serializer_for<Serializer, T>
+class data_pit_bridge_sender
+{
+public:
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit of the queue
+     * @param   queue_id    The id of the queue
+     * @param   socket      The connected socket, which the sender does not close
+     * @param   max_batch   The maximum number of data sent at once
+     */
+    data_pit_bridge_sender(data_pit& pit, int queue_id, int socket, size_t max_batch = 256)
+        : m_pit(&pit), m_consumer_id(pit.register_consumer(queue_id)), m_socket(socket), m_max_batch(max_batch) {}
+
+    data_pit_bridge_sender(const data_pit_bridge_sender&) = delete;
+    data_pit_bridge_sender& operator=(const data_pit_bridge_sender&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~data_pit_bridge_sender()
+    {
+        m_pit->unregister_consumer(m_consumer_id);
+    }
+
+    /**
+     * @brief               This function is used to send the data available in the queue, up to a batch
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The number of data sent, 0 if none are available or the sending fails
+     */
+    size_t forward(bool blocking = false, uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        m_batch.clear();
+        auto count = m_pit->consume_bulk<T>(m_consumer_id, std::back_inserter(m_batch), m_max_batch, blocking,
+                                            timeout_ms);
+        if (count == 0)
+        {
+            m_error = m_pit->get_last_error(m_consumer_id);
+            return 0;
+        }
+
+        // Serialize every data after its size, then send the header and the data at once
+        m_payload.clear();
+        for (auto& data : m_batch)
+        {
+            auto offset = m_payload.size();
+            m_payload.resize(offset + sizeof(uint32_t));
+            Serializer::serialize(data, m_payload);
+            auto size = static_cast<uint32_t>(m_payload.size() - offset - sizeof(uint32_t));
+            std::memcpy(m_payload.data() + offset, &size, sizeof(size));
+        }
+        data_pit_bridge_frame frame;
+        frame.count = static_cast<uint32_t>(count);
+        frame.bytes = m_payload.size();
+
+        if (!send_all(frame))
+        {
+            m_error = data_pit_result::connection_error;
+            return 0;
+        }
+        m_error = data_pit_result::success;
+        return count;
+    }
+
+    /**
+     * @brief               This function is used to forward the data of the queue until a stop is requested or
+     *                      the sending fails
+     * @param   token       The token of the stop, checked every timeout
+     * @param   timeout_ms  The maximum time waited for data before checking the token, in milliseconds
+     */
+    void run(std::stop_token token, uint32_t timeout_ms = 100)
+    {
+        while (!token.stop_requested())
+        {
+            forward(true, timeout_ms);
+            if (m_error == data_pit_result::connection_error || m_error == data_pit_result::consumer_not_found) return;
+        }
+    }
+
+    /**
+     * @brief               This function is used to get the last error of the sender
+     * @return              The last error: connection_error if the sending failed, or the last error of the consumer
+     */
+    data_pit_result get_last_error() const
+    {
+        return m_error;
+    }
+
+    /**
+     * @brief               This function is used to get the id of the consumer of the sender
+     * @return              The id of the consumer, or 0 if it could not be registered
+     */
+    unsigned int consumer_id() const
+    {
+        return m_consumer_id;
+    }
+
+private:
+    // Send a frame and its payload, resuming after partial writes
+    bool send_all(const data_pit_bridge_frame& frame)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        iovec buffers[2] = {{const_cast<data_pit_bridge_frame*>(&frame), sizeof(frame)},
+                            {m_payload.data(), m_payload.size()}};
+        size_t index = 0;
+        while (index < 2)
+        {
+            msghdr message{};
+            message.msg_iov = buffers + index;
+            message.msg_iovlen = 2 - index;
+#if defined(MSG_NOSIGNAL)
+            auto sent = sendmsg(m_socket, &message, MSG_NOSIGNAL);
+#else
+            auto sent = sendmsg(m_socket, &message, 0);
+#endif
+            if (sent < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            // Skip the buffers sent, then the part of the next one sent
+            auto remaining = static_cast<size_t>(sent);
+            while (index < 2 && remaining >= buffers[index].iov_len)
+            {
+                remaining -= buffers[index].iov_len;
+                ++index;
+            }
+            if (index < 2)
+            {
+                buffers[index].iov_base = static_cast<char*>(buffers[index].iov_base) + remaining;
+                buffers[index].iov_len -= remaining;
+            }
+        }
+        return true;
+#else
+        (void)frame;
+        return false;
+#endif
+    }
+
+    // The data_pit of the queue
+    data_pit* m_pit;
+    // The consumer tailing the queue
+    unsigned int m_consumer_id;
+    // The socket
+    int m_socket;
+    // The maximum number of data sent at once
+    size_t m_max_batch;
+    // The data of the batch being sent, kept to reuse their storage
+    std::vector<T> m_batch;
+    // The serialized data of the batch
+    std::vector<std::byte> m_payload;
+    // The last error
+    data_pit_result m_error = data_pit_result::success;
+};
+
+/**
+ * @brief data_pit_bridge_receiver class
+ *
+ * Receives the batches of data sent by a data_pit_bridge_sender over a connected stream socket, and produces them
+ * into a queue, whose consumers get them as if they were produced locally, broadcast included.
+ *
+ * @tparam T The type of the data of the queue
+ * @tparam Serializer The serializer of the data
+ */
+template<typename T, typename Serializer = data_pit_serializer<T>>
+requires data_pit_serializer_for<Serializer, T>
+class data_pit_bridge_receiver
+{
+public:
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit of the queue
+     * @param   queue_id    The id of the queue the data are produced into
+     * @param   socket      The connected socket, which the receiver does not close
+     * @param   max_count   The maximum number of data of a batch
+     * @param   max_bytes   The maximum number of bytes of a batch, following its header
+     * @note                A batch beyond the limits shuts the connection down, as corrupt or hostile data would
+     */
+    data_pit_bridge_receiver(data_pit& pit, int queue_id, int socket, size_t max_count = 65536,
+                             size_t max_bytes = size_t(64) << 20)
+        : m_pit(&pit), m_queue_id(queue_id), m_producer(pit.producer_handle(queue_id)), m_socket(socket),
+          m_max_count(max_count), m_max_bytes(max_bytes) {}
+
+    /**
+     * @brief               This function is used to receive a batch of data, and produce it into the queue
+     * @param   timeout_ms  The maximum time waited for a batch to start, in milliseconds
+     * @return              The number of data produced, 0 if no batch was received or the queue had no room
+     * @note                Once a batch starts, the function waits until all of it is received
+     * @note                The data the queue has no room for are kept, and produced by the next calls before any
+     *                      other batch is received, so that a full queue holds the sender back through the socket
+     */
+    size_t receive(uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        // The data of the last batch come first, since the sender consumed them already
+        if (pending() > 0) return produce_pending();
+
+        m_error = readable(timeout_ms);
+        if (m_error != data_pit_result::success) return 0;
+
+        // Receive the header, then the data it announces, within the limits of the receiver
+        data_pit_bridge_frame frame;
+        if (!receive_all(&frame, sizeof(frame)) || frame.magic != data_pit_bridge_frame::magic_value ||
+            frame.count > m_max_count || frame.bytes > m_max_bytes)
+        {
+            return disconnect();
+        }
+        m_payload.resize(static_cast<size_t>(frame.bytes));
+        if (!receive_all(m_payload.data(), m_payload.size())) return disconnect();
+
+        // Rebuild every data from its size and bytes
+        m_batch.clear();
+        m_produced = 0;
+        size_t offset = 0;
+        for (uint32_t i = 0; i < frame.count; ++i)
+        {
+            uint32_t size;
+            if (m_payload.size() - offset < sizeof(size)) return disconnect();
+            std::memcpy(&size, m_payload.data() + offset, sizeof(size));
+            offset += sizeof(size);
+
+            auto data = m_payload.size() - offset >= size
+                        ? Serializer::deserialize(std::span<const std::byte>(m_payload.data() + offset, size))
+                        : std::nullopt;
+            if (!data.has_value()) return disconnect();
+            m_batch.push_back(std::move(*data));
+            offset += size;
+        }
+
+        return produce_pending();
+    }
+
+    /**
+     * @brief               This function is used to receive batches until a stop is requested or the connection
+     *                      fails
+     * @param   token       The token of the stop, checked every timeout
+     * @param   timeout_ms  The maximum time waited for a batch before checking the token, in milliseconds
+     */
+    void run(std::stop_token token, uint32_t timeout_ms = 100)
+    {
+        while (!token.stop_requested())
+        {
+            receive(timeout_ms);
+            if (m_error == data_pit_result::connection_error) return;
+
+            // Wait a little for room in a queue that does not block its producers
+            if (pending() > 0 && m_error != data_pit_result::timeout_expired)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    /**
+     * @brief               This function is used to get the last error of the receiver
+     * @return              The last error: connection_error if the connection failed or sent invalid data,
+     *                      timeout_expired if no batch was received, or the result of producing the last data
+     */
+    data_pit_result get_last_error() const
+    {
+        return m_error;
+    }
+
+    /**
+     * @brief               This function is used to get the number of data received but not produced yet
+     * @return              The number of data waiting for room in the queue, which are lost if the receiver is
+     *                      destroyed
+     */
+    size_t pending() const
+    {
+        return m_batch.size() - m_produced;
+    }
+
+private:
+    // Wait until the socket is readable, returning timeout_expired if it is not, or connection_error if it cannot
+    // be polled
+    data_pit_result readable(uint32_t timeout_ms)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        pollfd descriptor{m_socket, POLLIN, 0};
+        auto timeout = timeout_ms > static_cast<uint32_t>(std::numeric_limits<int>::max())
+                       ? -1 : static_cast<int>(timeout_ms);
+        while (true)
+        {
+            auto result = ::poll(&descriptor, 1, timeout);
+            if (result > 0) return data_pit_result::success;
+            if (result == 0) return data_pit_result::timeout_expired;
+            if (errno != EINTR) return data_pit_result::connection_error;
+        }
+#else
+        (void)timeout_ms;
+        return data_pit_result::success;
+#endif
+    }
+
+    // Shut the connection down, since the rest of the stream can no longer be read, and fail the batch
+    size_t disconnect()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        shutdown(m_socket, SHUT_RDWR);
+#endif
+        m_batch.clear();
+        m_produced = 0;
+        m_error = data_pit_result::connection_error;
+        return 0;
+    }
+
+    // Produce the data of the batch not produced yet, in parts no larger than the queue, stopping at the first part
+    // the queue has no room for
+    size_t produce_pending()
+    {
+        auto start = m_produced;
+        m_error = data_pit_result::success;
+        while (m_produced < m_batch.size())
+        {
+            auto capacity = std::max<size_t>(m_pit->get_queue_capacity(m_queue_id).value_or(1), 1);
+            auto count = std::min(m_batch.size() - m_produced, capacity);
+            m_error = m_producer.produce_bulk<T>(std::span<const T>(m_batch.data() + m_produced, count));
+
+            // The data dropped by the overflow policy of the queue are given up on purpose
+            if (m_error != data_pit_result::success && m_error != data_pit_result::data_dropped) break;
+            m_produced += count;
+        }
+        return m_produced - start;
+    }
+
+    // Receive a number of bytes, failing if the connection is closed first
+    bool receive_all(void* buffer, size_t size)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        auto bytes = static_cast<char*>(buffer);
+        while (size > 0)
+        {
+            auto received = recv(m_socket, bytes, size, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+#else
+        (void)buffer;
+        return size == 0;
+#endif
+    }
+
+    // The data_pit of the queue
+    data_pit* m_pit;
+    // The id of the queue
+    int m_queue_id;
+    // The handle producing into the queue
+    data_pit_producer_handle m_producer;
+    // The socket
+    int m_socket;
+    // The maximum number of data of a batch
+    size_t m_max_count;
+    // The maximum number of bytes of a batch
+    size_t m_max_bytes;
+    // The received bytes of the batch
+    std::vector<std::byte> m_payload;
+    // The data of the batch
+    std::vector<T> m_batch;
+    // The number of data of the batch produced
+    size_t m_produced = 0;
+    // The last error
+    data_pit_result m_error = data_pit_result::success;
+};
@@ -0,0 +1,412 @@
+/*
+ *  data_pit_static.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "data_pit.h"
+
+/**
+ * @brief data_pit_queue struct
+ *
+ * The description of a queue of a data_pit_static, known at compile time.
+ *
+ * @tparam Id The id of the queue
+ * @tparam T The type of the data of the queue
+ * @tparam Mode The mode of the queue
+ * @tparam Size The maximum size of the queue
+ */
+template<int Id, typename T, data_pit_queue_mode Mode = data_pit_queue_mode::multi_producer,
+         size_t Size = DATA_PIT_MAX_QUEUE_SIZE>
+struct data_pit_queue
+{
+    static constexpr int id = Id;
+    typedef T type;
+    static constexpr data_pit_queue_mode mode = Mode;
+    static constexpr size_t size = Size;
+};
+
+/**
+ * @brief data_pit_static_consumer class
+ *
+ * A consumer of a queue of a data_pit_static, typed after the queue, which consumes without looking the consumer or
+ * its queue up and without checking the type of the data.
+ *
+ * @tparam T The type of the data of the queue
+ */
+template<typename T>
+class data_pit_static_consumer
+{
+public:
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    std::optional<T> consume(bool blocking = false, uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, false, 1,
+                                        [&](ring_buffer<T>& ring, uint64_t position, size_t)
+                                        {
+                                            data.emplace(ring.at(position));
+                                        });
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer, moving it out of
+     *                      the queue if no other consumer needs it
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The consumed data, or std::nullopt if no data are available
+     */
+    std::optional<T> consume_move(bool blocking = false, uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue
+        std::optional<T> data;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, false, 1,
+                                        m_pit->template move_reader<T>(*m_data, *m_consumer, data));
+        return data;
+    }
+
+    /**
+     * @brief               This function is used to consume data from the queue of the consumer without copying it
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              A view of the consumed data, or std::nullopt if no data are available
+     * @note                The view is valid until it is released, or the consumer consumes again, is unregistered,
+     *                      or the size of the queue is set
+     */
+    std::optional<data_pit_view<T>> consume_view(bool blocking = false,
+                                                 uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered()) return std::nullopt;
+
+        // Fetch the data from the queue, holding its slot
+        std::optional<data_pit_view<T>> view;
+        m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, false, 1,
+                                        m_pit->template view_reader<T>(m_consumer, view));
+        return view;
+    }
+
+    /**
+     * @brief               This function is used to consume a batch of data from the queue of the consumer
+     * @param   out         The destination of the consumed data
+     * @param   max_n       The maximum number of data to be consumed
+     * @param   blocking    If true, the function will wait until there are data available
+     * @param   timeout_ms  The maximum waiting time in milliseconds
+     * @return              The number of data consumed, 0 if no data are available
+     */
+    template<typename OutputIt>
+    size_t consume_bulk(OutputIt out, size_t max_n, bool blocking = false,
+                        uint32_t timeout_ms = std::numeric_limits<uint32_t>::max())
+    {
+        if (!registered() || max_n == 0) return 0;
+
+        // Fetch the data from the queue
+        return m_pit->template consume_data<T>(*m_data, *m_consumer, blocking, timeout_ms, false, max_n,
+                                               [&](ring_buffer<T>& ring, uint64_t position, size_t count)
+                                               {
+                                                   out = ring.copy(position, count, out);
+                                               });
+    }
+
+    /**
+     * @brief               This function is used to get the last error of the consumer
+     * @return              The last error of the consumer
+     */
+    data_pit_result get_last_error() const
+    {
+        return m_pit->data_pit_error(*m_consumer).load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief               This function is used to get the id of the consumer, to manage it through the data_pit
+     * @return              The id of the consumer
+     */
+    unsigned int consumer_id() const
+    {
+        return m_consumer_id;
+    }
+
+private:
+    template<typename...>
+    friend class data_pit_static;
+
+    /**
+     * @brief               This function is used to check that the consumer is still registered
+     * @return              True if the consumer is registered, otherwise the error of the consumer is set
+     */
+    bool registered()
+    {
+        if (m_pit->consumer_registered(*m_consumer).load(std::memory_order_acquire)) return true;
+        m_pit->data_pit_error(*m_consumer).store(data_pit_result::consumer_not_found, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief               Constructor
+     * @param   pit         The data_pit owning the consumer
+     * @param   consumer_id The id of the consumer
+     * @param   consumer    The data of the consumer
+     * @param   q_data      The data of the queue of the consumer, whose type is T
+     */
+    data_pit_static_consumer(data_pit& pit, unsigned int consumer_id,
+                             std::shared_ptr<data_pit::consumer_data_t> consumer, data_pit::data_t& q_data)
+        : m_pit(&pit), m_consumer_id(consumer_id), m_consumer(std::move(consumer)), m_data(&q_data) {}
+
+    // The data_pit owning the consumer
+    data_pit* m_pit;
+    // The id of the consumer
+    unsigned int m_consumer_id;
+    // The data of the consumer, which lives as long as the consumer
+    std::shared_ptr<data_pit::consumer_data_t> m_consumer;
+    // The data of the queue of the consumer, which lives as long as the data_pit
+    data_pit::data_t* m_data;
+};
+
+/**
+ * @brief data_pit_static class
+ *
+ * A data_pit whose queues are all known at compile time. Each queue is created with its type pinned when the
+ * data_pit_static is constructed, and its channel is kept in a fixed slot, which the id of the queue selects at
+ * compile time. Producing and consuming neither look the queue up nor check the type of the data, and data of
+ * the wrong type do not compile.
+ *
+ * The other operations, such as setting the policies of the queues, are available through pit().
+ *
+ * @tparam Queues The queues, as data_pit_queue types with distinct ids
+ */
+template<typename... Queues>
+class data_pit_static
+{
+    static_assert(sizeof...(Queues) > 0, "a data_pit_static needs at least one queue");
+
+    // Get the slot of the queue with an id, or the number of queues if there is none
+    template<int Id>
+    static constexpr size_t slot_of()
+    {
+        constexpr int ids[] = {Queues::id...};
+        for (size_t i = 0; i < sizeof...(Queues); ++i)
+        {
+            if (ids[i] == Id) return i;
+        }
+        return sizeof...(Queues);
+    }
+
+    // Check that the ids of the queues are distinct
+    static constexpr bool distinct_ids()
+    {
+        constexpr int ids[] = {Queues::id...};
+        for (size_t i = 0; i < sizeof...(Queues); ++i)
+        {
+            for (size_t j = i + 1; j < sizeof...(Queues); ++j)
+            {
+                if (ids[i] == ids[j]) return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(distinct_ids(), "the queues of a data_pit_static need distinct ids");
+
+    // Get the description of the queue with an id, which must exist
+    template<int Id>
+    struct queue_of
+    {
+        static_assert(slot_of<Id>() < sizeof...(Queues), "the data_pit_static has no queue with this id");
+        typedef std::tuple_element_t<std::min(slot_of<Id>(), sizeof...(Queues) - 1), std::tuple<Queues...>> type;
+    };
+
+public:
+    /**
+     * @brief The type of the data of the queue with an id
+     */
+    template<int Id>
+    using data_type = typename queue_of<Id>::type::type;
+
+    /**
+     * @brief               Constructor
+     * @param   resource    The memory resource the storage of the queues is allocated from
+     */
+    explicit data_pit_static(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_pit(resource), m_channels(open_channel<Queues>()...) {}
+
+    data_pit_static(const data_pit_static&) = delete;
+    data_pit_static& operator=(const data_pit_static&) = delete;
+
+    /**
+     * @brief               This function is used to produce data in a queue
+     * @tparam  Id          The id of the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     */
+    template<int Id>
+    data_pit_result produce(const data_type<Id>& data)
+    {
+        return channel<Id>().produce(data);
+    }
+
+    /**
+     * @brief               This function is used to produce data in a queue, moving it into the queue
+     * @tparam  Id          The id of the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                The data is left untouched if it is not produced
+     */
+    template<int Id>
+    data_pit_result produce(data_type<Id>&& data)
+    {
+        return channel<Id>().produce(std::move(data));
+    }
+
+    /**
+     * @brief               This function is used to produce data in a queue, constructing it in place
+     * @tparam  Id          The id of the queue
+     * @param   args        The arguments forwarded to the constructor of the data
+     * @return              The result of the operation
+     */
+    template<int Id, typename... Args>
+    data_pit_result emplace(Args&&... args)
+    {
+        return channel<Id>().emplace(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief               This function is used to produce a batch of data in a queue
+     * @tparam  Id          The id of the queue
+     * @param   data        The data to be produced
+     * @return              The result of the operation
+     * @note                Either the whole batch is produced or none of it
+     */
+    template<int Id>
+    data_pit_result produce_bulk(std::span<const data_type<Id>> data)
+    {
+        return channel<Id>().produce_bulk(data);
+    }
+
+    /**
+     * @brief               This function is used to register a consumer to a queue
+     * @tparam  Id          The id of the queue
+     * @param   group_id    The id of the group of the consumer, if any, as in data_pit::register_consumer
+     * @return              The consumer, or std::nullopt if the maximum number of consumers has been reached
+     */
+    template<int Id>
+    std::optional<data_pit_static_consumer<data_type<Id>>> register_consumer(std::optional<int> group_id = std::nullopt)
+    {
+        return make_consumer<Id>(m_pit.register_consumer(Id, group_id));
+    }
+
+    /**
+     * @brief               This function is used to register a consumer which only consumes the data of a queue
+     *                      matching a predicate, as in data_pit::register_consumer
+     * @tparam  Id          The id of the queue
+     * @param   predicate   The predicate
+     * @return              The consumer, or std::nullopt if the maximum number of consumers has been reached
+     */
+    template<int Id, typename Predicate>
+    requires std::predicate<Predicate&, const data_type<Id>&>
+    std::optional<data_pit_static_consumer<data_type<Id>>> register_consumer(Predicate predicate)
+    {
+        return make_consumer<Id>(m_pit.register_consumer<data_type<Id>>(Id, std::move(predicate)));
+    }
+
+    /**
+     * @brief               This function is used to unregister a consumer
+     * @param   consumer    The consumer, which consumes nothing once unregistered
+     */
+    template<typename T>
+    void unregister_consumer(const data_pit_static_consumer<T>& consumer)
+    {
+        m_pit.unregister_consumer(consumer.consumer_id());
+    }
+
+    /**
+     * @brief               This function is used to get the channel of a queue
+     * @tparam  Id          The id of the queue
+     * @return              The channel
+     */
+    template<int Id>
+    data_pit_channel<data_type<Id>>& channel()
+    {
+        return std::get<slot_of<Id>()>(m_channels);
+    }
+
+    /**
+     * @brief               This function is used to get the data_pit holding the queues
+     * @return              The data_pit
+     */
+    data_pit& pit()
+    {
+        return m_pit;
+    }
+
+private:
+    // Create a queue with its type pinned up front, which cannot fail since the data_pit holds no other queue yet
+    template<typename Queue>
+    data_pit_channel<typename Queue::type> open_channel()
+    {
+        data_pit_queue_options options;
+        options.mode = Queue::mode;
+        options.capacity = Queue::size;
+        [[maybe_unused]] auto result = m_pit.template create_queue<typename Queue::type>(Queue::id, options);
+        assert(result == data_pit_result::success);
+
+        auto channel = m_pit.template channel<typename Queue::type>(Queue::id);
+        assert(channel.has_value());
+        return *channel;
+    }
+
+    // Make the consumer of a queue from its id
+    template<int Id>
+    std::optional<data_pit_static_consumer<data_type<Id>>> make_consumer(unsigned int consumer_id)
+    {
+        if (consumer_id == 0) return std::nullopt;
+
+        // The consumer may have been unregistered through pit() meanwhile
+        auto consumer = m_pit.m_consumers_data.find(consumer_id);
+        if (!consumer.has_value()) return std::nullopt;
+        return data_pit_static_consumer<data_type<Id>>(m_pit, consumer_id, consumer.value(), *channel<Id>().m_data);
+    }
+
+    // The data_pit holding the queues
+    data_pit m_pit;
+    // The channels of the queues, in the order of the queues
+    std::tuple<data_pit_channel<typename Queues::type>...> m_channels;
+};
@@ -0,0 +1,189 @@
+/*
+ *  data_pit_stats.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "cache_line.h"
+
+/**
+ * @brief data_pit_queue_stats struct
+ *
+ * A snapshot of the statistics of a queue. The counters are read one at a time while the queue is in use, so they
+ * may not all match the same instant.
+ */
+struct data_pit_queue_stats
+{
+    // The number of latency buckets: bucket i counts the waits of less than 2^i microseconds, the last one the others
+    static constexpr size_t latency_buckets = 24;
+
+    // The number of data produced
+    uint64_t produced = 0;
+    // The number of data consumed, by all the consumers
+    uint64_t consumed = 0;
+    // The number of data retained by the queue
+    uint64_t depth = 0;
+    // The number of produce calls which found the queue full
+    uint64_t full = 0;
+    // The number of calls whose timeout expired
+    uint64_t timeouts = 0;
+    // The number of calls which failed with a type mismatch
+    uint64_t type_mismatches = 0;
+    // The number of times the mutex of the queue was found locked
+    uint64_t lock_contentions = 0;
+    // The total time spent waiting for the mutex of the queue, in nanoseconds
+    uint64_t lock_wait_ns = 0;
+    // The latencies of the blocking consumes
+    std::array<uint64_t, latency_buckets> wait_latency{};
+};
+
+/**
+ * @brief The counters of the statistics of a queue.
+ *
+ * The counters are striped over cache lines, and each thread increments the counters of its stripe with relaxed
+ * atomics, so that threads recording statistics on different cores rarely write to the same cache line.
+ */
+class data_pit_stats
+{
+public:
+    /**
+     * @brief           Record data produced.
+     *
+     * @param count     The number of data.
+     */
+    void record_produced(size_t count) { add(&stripe_t::produced, count); }
+
+    /**
+     * @brief           Record data consumed.
+     *
+     * @param count     The number of data.
+     */
+    void record_consumed(size_t count) { add(&stripe_t::consumed, count); }
+
+    /**
+     * @brief           Record a produce call which found the queue full.
+     */
+    void record_full() { add(&stripe_t::full, 1); }
+
+    /**
+     * @brief           Record a call whose timeout expired.
+     */
+    void record_timeout() { add(&stripe_t::timeouts, 1); }
+
+    /**
+     * @brief           Record a call which failed with a type mismatch.
+     */
+    void record_type_mismatch() { add(&stripe_t::type_mismatches, 1); }
+
+    /**
+     * @brief           Record a wait for the mutex of the queue.
+     *
+     * @param elapsed   The time spent waiting.
+     */
+    void record_lock_wait(std::chrono::steady_clock::duration elapsed)
+    {
+        add(&stripe_t::lock_contentions, 1);
+        add(&stripe_t::lock_wait_ns, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    /**
+     * @brief           Record the latency of a blocking consume.
+     *
+     * @param elapsed   The time spent in the call.
+     */
+    void record_wait(std::chrono::steady_clock::duration elapsed)
+    {
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        size_t bucket = 0;
+        while (bucket + 1 < data_pit_queue_stats::latency_buckets && us >= (uint64_t(1) << bucket)) ++bucket;
+        stripe().wait_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief           Sum the counters of all the stripes into a snapshot.
+     *
+     * @param stats     The snapshot, whose depth is left as is.
+     */
+    void collect(data_pit_queue_stats& stats) const
+    {
+        for (auto& s : m_stripes)
+        {
+            stats.produced += s.produced.load(std::memory_order_relaxed);
+            stats.consumed += s.consumed.load(std::memory_order_relaxed);
+            stats.full += s.full.load(std::memory_order_relaxed);
+            stats.timeouts += s.timeouts.load(std::memory_order_relaxed);
+            stats.type_mismatches += s.type_mismatches.load(std::memory_order_relaxed);
+            stats.lock_contentions += s.lock_contentions.load(std::memory_order_relaxed);
+            stats.lock_wait_ns += s.lock_wait_ns.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < data_pit_queue_stats::latency_buckets; ++i)
+            {
+                stats.wait_latency[i] += s.wait_latency[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    // The number of stripes
+    static constexpr size_t stripes_count = 8;
+
+    // The counters incremented by the threads of a stripe, on cache lines of their own
+    struct alignas(DATA_PIT_CACHE_LINE_SIZE) stripe_t
+    {
+        std::atomic<uint64_t> produced{0};
+        std::atomic<uint64_t> consumed{0};
+        std::atomic<uint64_t> full{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<uint64_t> type_mismatches{0};
+        std::atomic<uint64_t> lock_contentions{0};
+        std::atomic<uint64_t> lock_wait_ns{0};
+        std::array<std::atomic<uint64_t>, data_pit_queue_stats::latency_buckets> wait_latency{};
+    };
+
+    /**
+     * @brief           Return the stripe of the calling thread.
+     */
+    stripe_t& stripe()
+    {
+        static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % stripes_count;
+        return m_stripes[index];
+    }
+
+    /**
+     * @brief           Add a value to a counter of the stripe of the calling thread.
+     */
+    void add(std::atomic<uint64_t> stripe_t::* counter, uint64_t value)
+    {
+        (stripe().*counter).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // The stripes
+    std::array<stripe_t, stripes_count> m_stripes{};
+};
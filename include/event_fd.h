@@ -0,0 +1,149 @@
+/*
+ *  event_fd.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief A file descriptor that an event loop can wait on until it is signaled.
+ *
+ * The descriptor becomes readable once signaled, and stays readable until cleared, so it can be added to
+ * epoll, poll, select or io_uring along with sockets. Signaling a descriptor that is already signaled costs a single
+ * atomic exchange, without any system call.
+ *
+ * On Linux the descriptor is an eventfd; on the other POSIX systems it is the reading end of a pipe. Elsewhere no
+ * descriptor can be opened.
+ */
+class event_fd
+{
+public:
+    event_fd() = default;
+
+    event_fd(const event_fd&) = delete;
+    event_fd& operator=(const event_fd&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~event_fd()
+    {
+#if defined(__linux__)
+        if (m_fd != -1) close(m_fd);
+#elif defined(__unix__) || defined(__APPLE__)
+        if (m_fd != -1)
+        {
+            close(m_fd);
+            close(m_write_fd);
+        }
+#endif
+    }
+
+    /**
+     * @brief           Open the descriptor, unless it is open already.
+     *
+     * @return          The descriptor, or -1 if it cannot be opened.
+     * @note            Opening and clearing the descriptor must be serialized by the caller.
+     */
+    int open()
+    {
+        if (m_fd != -1) return m_fd;
+
+#if defined(__linux__)
+        m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif defined(__unix__) || defined(__APPLE__)
+        int fds[2];
+        if (pipe(fds) == 0)
+        {
+            for (auto fd : fds)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+            m_write_fd = fds[1];
+            m_fd = fds[0];
+        }
+#endif
+        m_open.store(m_fd != -1, std::memory_order_release);
+        return m_fd;
+    }
+
+    /**
+     * @brief           Check if the descriptor is open.
+     */
+    bool is_open() const { return m_open.load(std::memory_order_acquire); }
+
+    /**
+     * @brief           Make the descriptor readable, unless it is signaled already.
+     */
+    void signal()
+    {
+        if (!is_open() || m_signaled.exchange(true, std::memory_order_acq_rel)) return;
+
+#if defined(__linux__)
+        uint64_t value = 1;
+        [[maybe_unused]] auto written = write(m_fd, &value, sizeof(value));
+#elif defined(__unix__) || defined(__APPLE__)
+        char value = 1;
+        [[maybe_unused]] auto written = write(m_write_fd, &value, sizeof(value));
+#endif
+    }
+
+    /**
+     * @brief           Make the descriptor unreadable until it is signaled again.
+     */
+    void clear()
+    {
+        if (!is_open() || !m_signaled.exchange(false, std::memory_order_acq_rel)) return;
+
+#if defined(__linux__)
+        uint64_t value;
+        [[maybe_unused]] auto read_bytes = read(m_fd, &value, sizeof(value));
+#elif defined(__unix__) || defined(__APPLE__)
+        char value;
+        [[maybe_unused]] auto read_bytes = read(m_fd, &value, sizeof(value));
+#endif
+    }
+
+private:
+    // The descriptor to wait on
+    int m_fd = -1;
+#if !defined(__linux__)
+    // The writing end of the pipe
+    int m_write_fd = -1;
+#endif
+    // Whether the descriptor is open
+    std::atomic<bool> m_open{false};
+    // Whether the descriptor is readable
+    std::atomic<bool> m_signaled{false};
+};
@@ -0,0 +1,425 @@
+/*
+ *  flat_hash_map.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+/**
+ * @brief An open-addressing hash map storing its entries in a flat array of slots.
+ *
+ * The slots are split in groups of 16, each with 16 control bytes telling whether a slot is empty, deleted, or full,
+ * in which case the byte holds 7 bits of the hash of its key. A lookup compares the control bytes of a whole group
+ * at once (with SSE2 where available) and only touches the slots whose bytes match, so most lookups cost a single
+ * cache miss on the control bytes and one on the slot.
+ *
+ * The map offers the part of the std::unordered_map interface used by concurrent_hash_map. Unlike std::unordered_map,
+ * inserting may move the entries, which invalidates all the references and iterators to them.
+ *
+ * @tparam Key The key type.
+ * @tparam Value The value type, which must be movable.
+ * @tparam Hash The hash function.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class flat_hash_map
+{
+public:
+    using value_type = std::pair<const Key, Value>;
+
+    /**
+     * @brief A forward iterator over the entries of the map.
+     */
+    template <bool Const>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = flat_hash_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        basic_iterator() = default;
+
+        /**
+         * @brief           Convert an iterator to a const iterator.
+         */
+        operator basic_iterator<true>() const { return basic_iterator<true>(m_map, m_index); }
+
+        reference operator*() const { return *m_map->slot(m_index); }
+        pointer operator->() const { return m_map->slot(m_index); }
+
+        basic_iterator& operator++()
+        {
+            m_index = m_map->next_full(m_index + 1);
+            return *this;
+        }
+
+        basic_iterator operator++(int)
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+
+        bool operator==(const basic_iterator& other) const { return m_index == other.m_index; }
+
+    private:
+        friend class flat_hash_map;
+
+        using map_pointer = std::conditional_t<Const, const flat_hash_map*, flat_hash_map*>;
+
+        basic_iterator(map_pointer map, size_t index) : m_map(map), m_index(index) {}
+
+        // The map
+        map_pointer m_map = nullptr;
+        // The index of the slot
+        size_t m_index = 0;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    flat_hash_map() = default;
+
+    flat_hash_map(const flat_hash_map&) = delete;
+    flat_hash_map& operator=(const flat_hash_map&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~flat_hash_map()
+    {
+        clear();
+        deallocate();
+    }
+
+    iterator begin() { return iterator(this, next_full(0)); }
+    iterator end() { return iterator(this, m_capacity); }
+    const_iterator begin() const { return const_iterator(this, next_full(0)); }
+    const_iterator end() const { return const_iterator(this, m_capacity); }
+
+    /**
+     * @brief           Return the number of entries.
+     */
+    size_t size() const { return m_size; }
+
+    /**
+     * @brief           Check if the map has no entries.
+     */
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * @brief           Find the entry of a key.
+     *
+     * @param key       The key.
+     * @return          An iterator to the entry, or end() if the key is missing.
+     */
+    iterator find(const Key& key)
+    {
+        return iterator(this, find_index(key));
+    }
+
+    const_iterator find(const Key& key) const
+    {
+        return const_iterator(this, find_index(key));
+    }
+
+    /**
+     * @brief           Return a reference to the value of a key.
+     *
+     * @param key       The key.
+     * @return          The value.
+     * @throws          std::out_of_range if the key is missing.
+     */
+    Value& at(const Key& key)
+    {
+        auto index = find_index(key);
+        if (index == m_capacity) throw std::out_of_range("flat_hash_map::at");
+        return slot(index)->second;
+    }
+
+    /**
+     * @brief           Return a reference to the value of a key, inserting a default value if the key is missing.
+     *
+     * @param key       The key.
+     * @return          The value.
+     */
+    Value& operator[](const Key& key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    /**
+     * @brief           Insert an entry if the key is missing.
+     *
+     * @param key       The key.
+     * @param args      The arguments forwarded to the constructor of the value.
+     * @return          An iterator to the entry of the key, and true if it was inserted.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+    {
+        auto hash = hash_of(key);
+        auto index = find_index(key, hash);
+        if (index != m_capacity) return {iterator(this, index), false};
+
+        // Grow before the table gets too crowded for probing to stay short, or only drop the deleted slots if
+        // they are most of the crowd
+        if ((m_size + m_deleted + 1) * 8 > m_capacity * 7)
+        {
+            rehash((m_size + 1) * 16 > m_capacity * 7 ? m_capacity * 2 : m_capacity);
+        }
+
+        index = free_index(hash);
+        if (m_ctrl[index] == deleted) --m_deleted;
+        std::construct_at(slot(index), std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+        m_ctrl[index] = h2(hash);
+        ++m_size;
+        return {iterator(this, index), true};
+    }
+
+    /**
+     * @brief           Erase the entry of a key.
+     *
+     * @param key       The key.
+     * @return          The number of entries erased.
+     */
+    size_t erase(const Key& key)
+    {
+        auto index = find_index(key);
+        if (index == m_capacity) return 0;
+
+        std::destroy_at(slot(index));
+        m_ctrl[index] = deleted;
+        ++m_deleted;
+        --m_size;
+        return 1;
+    }
+
+    /**
+     * @brief           Erase all the entries, keeping the storage.
+     */
+    void clear()
+    {
+        for (size_t index = 0; index < m_capacity; ++index)
+        {
+            if (is_full(m_ctrl[index])) std::destroy_at(slot(index));
+        }
+        if (m_capacity > 0) std::memset(m_ctrl, empty_slot, m_capacity);
+        m_size = 0;
+        m_deleted = 0;
+    }
+
+private:
+    // The number of slots of a group
+    static constexpr size_t group_size = 16;
+    // The control byte of an empty slot
+    static constexpr int8_t empty_slot = static_cast<int8_t>(0x80);
+    // The control byte of a deleted slot
+    static constexpr int8_t deleted = static_cast<int8_t>(0xFE);
+
+    static bool is_full(int8_t ctrl) { return ctrl >= 0; }
+
+    static uint64_t hash_of(const Key& key)
+    {
+        // Mix the hash, since std::hash is the identity for integers
+        return static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // The 7 bits of the hash stored in the control byte
+    static int8_t h2(uint64_t hash) { return static_cast<int8_t>(hash >> 57); }
+
+    // The group where probing starts
+    size_t h1(uint64_t hash) const { return static_cast<size_t>(hash) & (m_capacity / group_size - 1); }
+
+    /**
+     * @brief           Return a bit mask of the slots of a group whose control byte is a given value.
+     */
+    uint32_t match(size_t group, int8_t value) const
+    {
+        const int8_t* ctrl = m_ctrl + group * group_size;
+#if defined(FLAT_HASH_MAP_SSE2)
+        auto bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < group_size; ++i)
+        {
+            if (ctrl[i] == value) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    /**
+     * @brief           Return a bit mask of the slots of a group that are empty or deleted.
+     */
+    uint32_t match_free(size_t group) const
+    {
+        const int8_t* ctrl = m_ctrl + group * group_size;
+#if defined(FLAT_HASH_MAP_SSE2)
+        // The control bytes of the free slots are the only negative ones
+        auto bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < group_size; ++i)
+        {
+            if (!is_full(ctrl[i])) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    size_t find_index(const Key& key) const
+    {
+        return m_capacity == 0 ? 0 : find_index(key, hash_of(key));
+    }
+
+    /**
+     * @brief           Return the index of the slot of a key, or m_capacity if the key is missing.
+     */
+    size_t find_index(const Key& key, uint64_t hash) const
+    {
+        if (m_capacity == 0) return 0;
+
+        // Probe the groups quadratically until a group with an empty slot, which ends every probe sequence
+        auto groups_mask = m_capacity / group_size - 1;
+        auto group = h1(hash);
+        for (size_t step = 1; step <= groups_mask + 1; ++step)
+        {
+            for (auto mask = match(group, h2(hash)); mask != 0; mask &= mask - 1)
+            {
+                auto index = group * group_size + static_cast<size_t>(std::countr_zero(mask));
+                if (slot(index)->first == key) return index;
+            }
+            if (match(group, empty_slot) != 0) return m_capacity;
+            group = (group + step) & groups_mask;
+        }
+        return m_capacity;
+    }
+
+    /**
+     * @brief           Return the index of the first free slot of the probe sequence of a hash.
+     */
+    size_t free_index(uint64_t hash) const
+    {
+        auto groups_mask = m_capacity / group_size - 1;
+        auto group = h1(hash);
+        for (size_t step = 1;; ++step)
+        {
+            auto mask = match_free(group);
+            if (mask != 0) return group * group_size + static_cast<size_t>(std::countr_zero(mask));
+            group = (group + step) & groups_mask;
+        }
+    }
+
+    /**
+     * @brief           Move all the entries to a new table, dropping the deleted slots.
+     *
+     * @param capacity  The number of slots of the new table, a power of two no lower than group_size.
+     */
+    void rehash(size_t capacity)
+    {
+        capacity = std::max(capacity, group_size);
+        auto old_ctrl = m_ctrl;
+        auto old_slots = m_slots;
+        auto old_capacity = m_capacity;
+
+        m_ctrl = static_cast<int8_t*>(::operator new(capacity, std::align_val_t(group_size)));
+        std::memset(m_ctrl, empty_slot, capacity);
+        m_slots = std::allocator<value_type>().allocate(capacity);
+        m_capacity = capacity;
+        m_deleted = 0;
+
+        for (size_t index = 0; index < old_capacity; ++index)
+        {
+            if (!is_full(old_ctrl[index])) continue;
+
+            auto& entry = old_slots[index];
+            auto hash = hash_of(entry.first);
+            auto new_index = free_index(hash);
+            std::construct_at(slot(new_index), std::piecewise_construct, std::forward_as_tuple(entry.first),
+                              std::forward_as_tuple(std::move(entry.second)));
+            m_ctrl[new_index] = h2(hash);
+            std::destroy_at(&entry);
+        }
+
+        if (old_capacity > 0)
+        {
+            ::operator delete(old_ctrl, std::align_val_t(group_size));
+            std::allocator<value_type>().deallocate(old_slots, old_capacity);
+        }
+    }
+
+    void deallocate()
+    {
+        if (m_capacity == 0) return;
+        ::operator delete(m_ctrl, std::align_val_t(group_size));
+        std::allocator<value_type>().deallocate(m_slots, m_capacity);
+    }
+
+    /**
+     * @brief           Return the index of the first full slot from a given index, or m_capacity if there is none.
+     */
+    size_t next_full(size_t index) const
+    {
+        while (index < m_capacity && !is_full(m_ctrl[index]))
+        {
+            ++index;
+        }
+        return index;
+    }
+
+    value_type* slot(size_t index) { return m_slots + index; }
+    const value_type* slot(size_t index) const { return m_slots + index; }
+
+    // The control bytes, aligned on a group
+    int8_t* m_ctrl = nullptr;
+    // The slots
+    value_type* m_slots = nullptr;
+    // The number of slots, a power of two multiple of group_size, or 0 before the first insertion
+    size_t m_capacity = 0;
+    // The number of entries
+    size_t m_size = 0;
+    // The number of deleted slots
+    size_t m_deleted = 0;
+};
@@ -0,0 +1,555 @@
+/*
+ *  mapped_ring.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "wait_sequence.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The header page of a mapped ring, which keeps the sequence numbers of the ring and the positions of its
+ *        consumers.
+ *
+ * The fields are aligned on 64 bytes rather than on DATA_PIT_CACHE_LINE_SIZE, since the layout is shared with the
+ * files and the processes built with another line size.
+ */
+struct mapped_ring_header
+{
+    // The value of the magic number of an initialized header, "DATA_PIT"
+    static constexpr uint64_t magic_value = 0x5449505f41544144ull;
+    // The version of the layout
+    static constexpr uint32_t layout_version = 2;
+    // The maximum number of consumers
+    static constexpr size_t max_cursors = 64;
+
+    // The state of the position of a consumer
+    enum cursor_state : uint32_t
+    {
+        free_cursor = 0,
+        named_cursor = 1,
+        anonymous_cursor = 2
+    };
+
+    // The position of a consumer: a named consumer keeps it across processes, an anonymous one only while registered
+    struct alignas(32) cursor_t
+    {
+        // The state of the position
+        std::atomic<uint32_t> state{free_cursor};
+        // The name of a named consumer
+        uint32_t name = 0;
+        // The process the consumer is registered in, or 0
+        std::atomic<int32_t> owner{0};
+        // The position of the next item to be consumed
+        std::atomic<uint64_t> index{0};
+    };
+
+    // The magic number, written once the rest of the header is initialized
+    std::atomic<uint64_t> magic{0};
+    // The version of the layout
+    uint32_t version = layout_version;
+    // The size of the items
+    uint32_t item_size = 0;
+    // The alignment of the items
+    uint64_t item_align = 0;
+    // The number of slots
+    uint64_t capacity = 0;
+    // The sequence number of the next item
+    alignas(64) std::atomic<uint64_t> head{0};
+    // The sequence number of the oldest item
+    alignas(64) std::atomic<uint64_t> tail{0};
+    // The position of the first item not cleared
+    std::atomic<uint64_t> floor{0};
+#if defined(__linux__)
+    // The sequence the consumers wait on, in every process
+    alignas(64) wait_sequence signal{true};
+    // The sequence the producer waits on when the ring is full
+    alignas(64) wait_sequence space{true};
+#endif
+    // The process changing the positions of the consumers, or 0
+    alignas(64) std::atomic<int32_t> cursors_lock{0};
+    // The positions of the consumers
+    std::array<cursor_t, max_cursors> cursors{};
+};
+
+/**
+ * @brief The slots of a ring buffer of trivially copyable items, stored in a memory-mapped file or shared memory
+ *        object along with a header page.
+ *
+ * The items, the sequence numbers and the positions of the consumers are kept in the mapping, so another process
+ * can map it meanwhile, or once the process stops, whether it exits or crashes, and find the ring as it is. The
+ * operating system writes the pages of a file in the background; sync forces it to, which the items need to survive
+ * a crash of the operating system itself.
+ *
+ * Files and shared memory objects can be mapped on POSIX systems only; elsewhere opening always fails.
+ */
+class mapped_ring
+{
+public:
+    // The size of the header page, which keeps the slots aligned for any item
+    static constexpr size_t header_size = 4096;
+
+    mapped_ring(const mapped_ring&) = delete;
+    mapped_ring& operator=(const mapped_ring&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~mapped_ring()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        // The named consumers keep their positions for the next process, the anonymous ones are forgotten
+        lock_cursors();
+        for (size_t i = 0; i < mapped_ring_header::max_cursors; ++i)
+        {
+            if (m_attached[i]) release(header().cursors[i]);
+        }
+        unlock_cursors();
+
+        munmap(m_address, m_size);
+        close(m_fd);
+#endif
+    }
+
+    /**
+     * @brief           Map a file, creating an empty ring in it if the file is new or empty, or holds a ring whose
+     *                  creation was interrupted.
+     *
+     * @param path      The path of the file.
+     * @param capacity  The number of slots of a new ring; an existing ring keeps its own.
+     * @param item_size The size of the items of a new ring.
+     * @param item_align The alignment of the items of a new ring.
+     * @return          The mapped ring, or nullptr if the file cannot be mapped or holds something else than a ring.
+     * @note            The processes opening the same file lock it, so that only one of them creates the ring.
+     */
+    static std::unique_ptr<mapped_ring> open(const std::string& path, size_t capacity, size_t item_size,
+                                             size_t item_align)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        size_t size = 0;
+        if (capacity == 0 || item_align > header_size || !ring_size(capacity, item_size, size)) return nullptr;
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) return nullptr;
+        return attach(fd, size, capacity, item_size, item_align);
+#else
+        (void)path;
+        (void)capacity;
+        (void)item_size;
+        (void)item_align;
+        return nullptr;
+#endif
+    }
+
+    /**
+     * @brief           Map a shared memory object, creating it with an empty ring if it does not exist.
+     *
+     * @param name      The name of the object, which starts with a slash.
+     * @param capacity  The number of slots of a new ring; an existing ring keeps its own.
+     * @param item_size The size of the items of a new ring.
+     * @param item_align The alignment of the items of a new ring.
+     * @return          The mapped ring, or nullptr if the object cannot be mapped.
+     * @note            A process opening an object that another process is creating waits until it is created. An
+     *                  object whose creator stopped before publishing its header is created again by the next process
+     *                  opening it with the same capacity and item size; with others, it stays unusable until it is
+     *                  removed with remove_shared.
+     */
+    static std::unique_ptr<mapped_ring> open_shared(const std::string& name, size_t capacity, size_t item_size,
+                                                    size_t item_align)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        size_t size = 0;
+        if (capacity == 0 || item_align > header_size || !ring_size(capacity, item_size, size)) return nullptr;
+
+        // The process creating the object removes it if it cannot create the ring, so that no process waits for it
+        auto created = true;
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd == -1)
+        {
+            created = false;
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd == -1) return nullptr;
+        }
+
+        auto ring = attach(fd, size, capacity, item_size, item_align);
+        if (ring == nullptr && created) shm_unlink(name.c_str());
+        return ring;
+#else
+        (void)name;
+        (void)capacity;
+        (void)item_size;
+        (void)item_align;
+        return nullptr;
+#endif
+    }
+
+    /**
+     * @brief           Remove a shared memory object, which stays mapped by the processes mapping it.
+     *
+     * @param name      The name of the object.
+     * @return          True if the object was removed.
+     */
+    static bool remove_shared(const std::string& name)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return shm_unlink(name.c_str()) == 0;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    /**
+     * @brief           Check if the ring holds items of a given size and alignment.
+     */
+    bool holds(size_t item_size, size_t item_align) const
+    {
+        auto& h = *static_cast<const mapped_ring_header*>(m_address);
+        return h.version == mapped_ring_header::layout_version && h.item_size == item_size &&
+               h.item_align == item_align;
+    }
+
+    /**
+     * @brief           Return the header of the ring.
+     */
+    mapped_ring_header& header() { return *static_cast<mapped_ring_header*>(m_address); }
+
+    /**
+     * @brief           Return the slots of the ring.
+     */
+    void* slots() { return static_cast<char*>(m_address) + header_size; }
+
+    /**
+     * @brief           Return the position of a named consumer, adding it if it is not known yet.
+     *
+     * @param name      The name of the consumer, which stays the same across processes.
+     * @param index     The position of a new consumer.
+     * @return          The position, or nullptr if the consumer is registered already or no position is free.
+     */
+    std::atomic<uint64_t>* attach(uint32_t name, uint64_t index)
+    {
+        return attach_cursor(mapped_ring_header::named_cursor, name, index);
+    }
+
+    /**
+     * @brief           Return the position of a new anonymous consumer, which is forgotten once detached.
+     *
+     * @param index     The position of the consumer.
+     * @return          The position, or nullptr if no position is free.
+     */
+    std::atomic<uint64_t>* attach_anonymous(uint64_t index)
+    {
+        return attach_cursor(mapped_ring_header::anonymous_cursor, 0, index);
+    }
+
+    /**
+     * @brief           Forget the position of a consumer.
+     *
+     * @param index     The position returned by attach or attach_anonymous.
+     */
+    void detach(std::atomic<uint64_t>* index)
+    {
+        lock_cursors();
+        for (size_t i = 0; i < mapped_ring_header::max_cursors; ++i)
+        {
+            auto& cursor = header().cursors[i];
+            if (&cursor.index != index) continue;
+
+            m_attached[i] = false;
+            cursor.owner.store(0, std::memory_order_relaxed);
+            cursor.state.store(mapped_ring_header::free_cursor, std::memory_order_release);
+        }
+        unlock_cursors();
+    }
+
+    /**
+     * @brief           Return the position of the slowest consumer, in any process, registered or not.
+     *
+     * @param head      The position returned if there are no consumers.
+     * @note            The anonymous consumers of the processes that stopped without unregistering them are forgotten.
+     */
+    uint64_t oldest_cursor(uint64_t head)
+    {
+        auto oldest = head;
+        bool stale = false;
+        for (auto& cursor : header().cursors)
+        {
+            auto state = cursor.state.load(std::memory_order_acquire);
+            if (state == mapped_ring_header::free_cursor) continue;
+            if (state == mapped_ring_header::anonymous_cursor && !alive(cursor.owner.load(std::memory_order_relaxed)))
+            {
+                stale = true;
+                continue;
+            }
+            oldest = std::min(oldest, cursor.index.load(std::memory_order_acquire));
+        }
+        if (stale) release_stale();
+        return oldest;
+    }
+
+    /**
+     * @brief           Write the mapped pages to the file.
+     *
+     * @return          True if the pages were written.
+     */
+    bool sync()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return msync(m_address, m_size, MS_SYNC) == 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    mapped_ring(int fd, void* address, size_t size) : m_fd(fd), m_address(address), m_size(size) {}
+
+    // Get the size of the mapping of a ring, unless it does not fit in memory
+    static bool ring_size(uint64_t capacity, uint64_t item_size, size_t& size)
+    {
+        if (item_size == 0 || capacity > (std::numeric_limits<size_t>::max() - header_size) / item_size) return false;
+        size = header_size + static_cast<size_t>(capacity * item_size);
+        return true;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Check if a descriptor refers to an initialized ring, getting the size of its mapping
+    static bool initialized(int fd, size_t& size)
+    {
+        struct stat status{};
+        if (fstat(fd, &status) == -1 || static_cast<size_t>(status.st_size) < header_size) return false;
+
+        auto address = mmap(nullptr, header_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) return false;
+        auto& header = *static_cast<const mapped_ring_header*>(address);
+        auto valid = header.magic.load(std::memory_order_acquire) == mapped_ring_header::magic_value &&
+                     ring_size(header.capacity, header.item_size, size) &&
+                     size <= static_cast<size_t>(status.st_size);
+        munmap(address, header_size);
+        return valid;
+    }
+
+    // Map a descriptor, creating an empty ring in it if it is empty or holds a ring whose creation was interrupted,
+    // and closing it on failure
+    static std::unique_ptr<mapped_ring> attach(int fd, size_t size, size_t capacity, size_t item_size,
+                                               size_t item_align)
+    {
+        // The lock is held until the ring is mapped, and initialized if it was not
+        while (flock(fd, LOCK_EX) == -1)
+        {
+            if (errno != EINTR)
+            {
+                close(fd);
+                return nullptr;
+            }
+        }
+
+        std::unique_ptr<mapped_ring> ring;
+        struct stat status{};
+        size_t existing = 0;
+        if (initialized(fd, existing))
+        {
+            ring = map(fd, existing, 0, 0, 0);
+        }
+        else if (fstat(fd, &status) == 0 &&
+                 (status.st_size == 0 ? ftruncate(fd, static_cast<off_t>(size)) == 0 : unpublished(fd, status, size)))
+        {
+            // The magic number is written last, so a descriptor of the size of the ring without one was being
+            // created by a process that stopped meanwhile
+            ring = map(fd, size, capacity, item_size, item_align);
+        }
+        else
+        {
+            // A descriptor holding something else than a ring is never overwritten
+            close(fd);
+            return nullptr;
+        }
+
+        // The descriptor is closed if the mapping failed, releasing the lock
+        if (ring != nullptr) flock(fd, LOCK_UN);
+        return ring;
+    }
+
+    // Check if a descriptor refers to a ring of a given size whose header was never published
+    static bool unpublished(int fd, const struct stat& status, size_t size)
+    {
+        uint64_t magic = 0;
+        return static_cast<size_t>(status.st_size) == size &&
+               pread(fd, &magic, sizeof(magic), offsetof(mapped_ring_header, magic)) == sizeof(magic) && magic == 0;
+    }
+
+    // Map a descriptor, initializing an empty ring in it unless its capacity is 0
+    static std::unique_ptr<mapped_ring> map(int fd, size_t size, size_t capacity, size_t item_size,
+                                            size_t item_align)
+    {
+        auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        std::unique_ptr<mapped_ring> ring(new mapped_ring(fd, address, size));
+        if (capacity != 0)
+        {
+            // Publish the header once initialized, so that no process maps a ring whose header is half written
+            auto& header = *new (address) mapped_ring_header();
+            header.item_size = static_cast<uint32_t>(item_size);
+            header.item_align = item_align;
+            header.capacity = capacity;
+            header.magic.store(mapped_ring_header::magic_value, std::memory_order_release);
+        }
+        return ring;
+    }
+#endif
+
+    // Check if a process is running
+    static bool alive(int32_t pid)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return pid != 0 && (kill(pid, 0) == 0 || errno == EPERM);
+#else
+        return pid != 0;
+#endif
+    }
+
+    // Return the id of the process
+    static int32_t self()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return static_cast<int32_t>(getpid());
+#else
+        return 1;
+#endif
+    }
+
+    // Lock the positions of the consumers, taking the lock over from a process that stopped while holding it
+    void lock_cursors()
+    {
+        auto& lock = header().cursors_lock;
+        while (true)
+        {
+            int32_t holder = 0;
+            if (lock.compare_exchange_weak(holder, self(), std::memory_order_acquire)) return;
+            if (holder != 0 && !alive(holder)) lock.compare_exchange_strong(holder, 0, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock_cursors()
+    {
+        header().cursors_lock.store(0, std::memory_order_release);
+    }
+
+    // Release the position of a consumer no longer registered, which stays known if it is named
+    static void release(mapped_ring_header::cursor_t& cursor)
+    {
+        cursor.owner.store(0, std::memory_order_relaxed);
+        if (cursor.state.load(std::memory_order_relaxed) == mapped_ring_header::anonymous_cursor)
+        {
+            cursor.state.store(mapped_ring_header::free_cursor, std::memory_order_release);
+        }
+    }
+
+    // Release the positions of the consumers of the processes that stopped without releasing them
+    void release_stale()
+    {
+        lock_cursors();
+        for (auto& cursor : header().cursors)
+        {
+            auto owner = cursor.owner.load(std::memory_order_relaxed);
+            if (owner != 0 && !alive(owner)) release(cursor);
+        }
+        unlock_cursors();
+    }
+
+    // Find or add the position of a consumer
+    std::atomic<uint64_t>* attach_cursor(uint32_t state, uint32_t name, uint64_t index)
+    {
+        release_stale();
+        lock_cursors();
+        mapped_ring_header::cursor_t* found = nullptr;
+        mapped_ring_header::cursor_t* free = nullptr;
+        for (auto& cursor : header().cursors)
+        {
+            auto cursor_state = cursor.state.load(std::memory_order_relaxed);
+            if (cursor_state == mapped_ring_header::free_cursor)
+            {
+                if (free == nullptr) free = &cursor;
+            }
+            else if (state == mapped_ring_header::named_cursor && cursor_state == state && cursor.name == name)
+            {
+                found = &cursor;
+            }
+        }
+
+        // A named consumer registered in a running process cannot be registered again
+        if (found != nullptr && found->owner.load(std::memory_order_relaxed) != 0) found = nullptr;
+        else if (found == nullptr && free != nullptr)
+        {
+            found = free;
+            found->name = name;
+            found->index.store(index, std::memory_order_relaxed);
+            found->state.store(state, std::memory_order_release);
+        }
+        if (found != nullptr)
+        {
+            found->owner.store(self(), std::memory_order_relaxed);
+            m_attached[found - header().cursors.data()] = true;
+        }
+        unlock_cursors();
+        return found != nullptr ? &found->index : nullptr;
+    }
+
+    static_assert(sizeof(mapped_ring_header) <= header_size, "the header must fit in its page");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the header must be usable by other processes");
+
+    // The descriptor of the mapped file or object
+    [[maybe_unused]] int m_fd;
+    // The address of the mapping
+    void* m_address;
+    // The size of the mapping
+    [[maybe_unused]] size_t m_size;
+    // Whether each position is attached to a consumer by this ring
+    std::array<bool, mapped_ring_header::max_cursors> m_attached{};
+};
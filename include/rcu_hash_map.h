@@ -0,0 +1,305 @@
+/*
+ *  rcu_hash_map.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cache_line.h"
+
+/**
+ * @brief A concurrent hash map for keys that are looked up far more often than they are inserted or erased.
+ *
+ * Readers look keys up in an immutable snapshot of the map without taking any lock. Writers copy the snapshot,
+ * change the copy, publish it, then wait for the readers that may still use the old snapshot before deleting it.
+ * Readers announce themselves on counters striped over cache lines, so readers on different cores rarely share one.
+ *
+ * The values are allocated once and shared by the snapshots, so the references to a value stay valid until its key
+ * is erased or assigned, whatever is inserted meanwhile. Since every write copies the map, the map suits tables that change
+ * rarely; a write must not be made by a thread while it looks a key up.
+ *
+ * @tparam Key The key type.
+ * @tparam Value The value type.
+ */
+template <typename Key, typename Value>
+class rcu_hash_map
+{
+public:
+    rcu_hash_map() : m_current(new snapshot_t()) {}
+
+    rcu_hash_map(const rcu_hash_map&) = delete;
+    rcu_hash_map& operator=(const rcu_hash_map&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~rcu_hash_map()
+    {
+        delete m_current.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief           Erase a key-value pair into the map.
+     *
+     * @param key       The key.
+     * @return          True if the key-value pair was erased, false otherwise.
+     */
+    bool erase(const Key& key)
+    {
+        std::lock_guard lock(m_write_mutex);
+        auto current = m_current.load(std::memory_order_relaxed);
+        if (current->find(key) == current->end()) return false;
+
+        auto next = std::make_unique<snapshot_t>(*current);
+        next->erase(key);
+        publish(std::move(next));
+        return true;
+    }
+
+    /**
+     * @brief           Find a key-value pair into the map.
+     *
+     * @param key       The key.
+     * @return          The value if the key was found, std::nullopt otherwise.
+     */
+    std::optional<Value> find(const Key& key) const
+    {
+        read_guard guard(*this);
+        auto it = guard.current->find(key);
+        if (it != guard.current->end())
+        {
+            return *it->second;
+        }
+        else
+        {
+            return std::nullopt;
+        }
+    }
+
+    /**
+     * @brief           Check if the map contains a key.
+     *
+     * @param key       The key.
+     * @return          True if the key was found, false otherwise.
+     */
+    bool contains(const Key& key) const
+    {
+        read_guard guard(*this);
+        return guard.current->find(key) != guard.current->end();
+    }
+
+    /**
+     * @brief           Operator[] overload to access the map.
+     *
+     * @param key       The key.
+     * @return          The value, which is default constructed if the key is missing.
+     */
+    Value& operator[](const Key& key)
+    {
+        return find_or_insert(key, [](Value&) {});
+    }
+
+    /**
+     * @brief           Insert a key-value pair into the map, or assign the value if the key is already there.
+     *
+     * @param key       The key.
+     * @param value     The value.
+     * @return          True if the key-value pair was inserted, false if the value was assigned.
+     * @note            The value is replaced rather than assigned, so readers of the old value never see it change.
+     */
+    bool insert_or_assign(const Key& key, const Value& value)
+    {
+        std::lock_guard lock(m_write_mutex);
+        auto next = std::make_unique<snapshot_t>(*m_current.load(std::memory_order_relaxed));
+        auto inserted = next->insert_or_assign(key, std::make_shared<Value>(value)).second;
+        publish(std::move(next));
+        return inserted;
+    }
+
+    /**
+     * @brief           Return a reference to the value associated with the key, inserting it if the key is missing.
+     *
+     * @param key       The key.
+     * @param init      The function called on a new value before any other thread can access it.
+     * @return          The value.
+     */
+    template <typename Init>
+    Value& find_or_insert(const Key& key, Init&& init)
+    {
+        {
+            read_guard guard(*this);
+            auto it = guard.current->find(key);
+            if (it != guard.current->end()) return *it->second;
+        }
+
+        std::lock_guard lock(m_write_mutex);
+        auto current = m_current.load(std::memory_order_relaxed);
+        auto it = current->find(key);
+        if (it != current->end()) return *it->second;
+
+        auto value = std::make_shared<Value>();
+        init(*value);
+        auto next = std::make_unique<snapshot_t>(*current);
+        next->emplace(key, value);
+        publish(std::move(next));
+        return *value;
+    }
+
+    /**
+     * @brief           Return a reference to the value associated with the key.
+     *
+     * @param key       The key.
+     * @return          The value, which stays valid until the key is erased or assigned.
+     * @throws          std::out_of_range if the key is missing.
+     */
+    Value& at(const Key& key)
+    {
+        read_guard guard(*this);
+        return *guard.current->at(key);
+    }
+
+    /**
+     * @brief           Return the keys currently stored in the map.
+     *
+     * @return          A copy of the keys.
+     */
+    std::vector<Key> keys() const
+    {
+        read_guard guard(*this);
+        std::vector<Key> keys;
+        keys.reserve(guard.current->size());
+        for (const auto& [key, value] : *guard.current)
+        {
+            keys.push_back(key);
+        }
+        return keys;
+    }
+
+    /**
+     * @brief           Clear the map.
+     */
+    void clear()
+    {
+        std::lock_guard lock(m_write_mutex);
+        if (m_current.load(std::memory_order_relaxed)->empty()) return;
+        publish(std::make_unique<snapshot_t>());
+    }
+
+private:
+    // The snapshot of the map, whose values are shared with the other snapshots
+    typedef std::unordered_map<Key, std::shared_ptr<Value>> snapshot_t;
+
+    // The number of reader counters
+    static constexpr size_t stripes_count = 16;
+
+    // The counters of the readers of the two last epochs, on their own cache line
+    struct alignas(DATA_PIT_CACHE_LINE_SIZE) stripe_t
+    {
+        std::array<std::atomic<int64_t>, 2> readers{};
+    };
+
+    /**
+     * @brief A reader of the current snapshot, which is not deleted until the reader is destroyed.
+     */
+    struct read_guard
+    {
+        explicit read_guard(const rcu_hash_map& map) : readers(map.stripe().readers)
+        {
+            // Count the reader in the current epoch, unless a writer ended it meanwhile
+            while (true)
+            {
+                epoch = map.m_epoch.load(std::memory_order_seq_cst) & 1;
+                readers[epoch].fetch_add(1, std::memory_order_seq_cst);
+                if ((map.m_epoch.load(std::memory_order_seq_cst) & 1) == epoch) break;
+                readers[epoch].fetch_sub(1, std::memory_order_release);
+            }
+            current = map.m_current.load(std::memory_order_seq_cst);
+        }
+
+        ~read_guard()
+        {
+            readers[epoch].fetch_sub(1, std::memory_order_release);
+        }
+
+        read_guard(const read_guard&) = delete;
+        read_guard& operator=(const read_guard&) = delete;
+
+        // The reader counters of the stripe of the thread
+        std::array<std::atomic<int64_t>, 2>& readers;
+        // The parity of the epoch of the reader
+        uint64_t epoch = 0;
+        // The snapshot read
+        const snapshot_t* current = nullptr;
+    };
+
+    /**
+     * @brief           Return the reader counters of the calling thread.
+     */
+    stripe_t& stripe() const
+    {
+        static thread_local size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % stripes_count;
+        return m_stripes[index];
+    }
+
+    /**
+     * @brief           Replace the current snapshot, deleting the old one once no reader uses it.
+     *
+     * @param next      The new snapshot.
+     * @note            The write mutex must be locked.
+     */
+    void publish(std::unique_ptr<snapshot_t> next)
+    {
+        std::unique_ptr<snapshot_t> old(m_current.exchange(next.release(), std::memory_order_seq_cst));
+
+        // New readers count themselves in the next epoch and read the new snapshot, so only the readers of the
+        // current epoch may still read the old one
+        auto epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+        for (auto& stripe : m_stripes)
+        {
+            while (stripe.readers[epoch].load(std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // The current snapshot
+    std::atomic<snapshot_t*> m_current;
+    // The epoch, which a writer advances when it publishes a snapshot
+    std::atomic<uint64_t> m_epoch{0};
+    // The reader counters
+    mutable std::array<stripe_t, stripes_count> m_stripes{};
+    // The mutex serializing the writers
+    std::mutex m_write_mutex;
+};
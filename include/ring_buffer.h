@@ -0,0 +1,511 @@
+/*
+ *  ring_buffer.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "cache_line.h"
+#include "mapped_ring.h"
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * @brief How the slots of a ring buffer are allocated.
+ */
+struct ring_buffer_placement
+{
+    // Whether the capacity is rounded up to a power of two, so that sequence numbers map to slots with a mask
+    bool power_of_two = false;
+    // Whether the pages of the slots are touched when they are allocated, so that they never fault afterwards
+    bool prefault = false;
+    // The NUMA node the pages of the slots are preferably taken from, or -1 for the policy of the allocating thread
+    int numa_node = -1;
+};
+
+/**
+ * @brief The part of a ring buffer that does not depend on the item type.
+ *
+ * Every item gets a monotonically increasing sequence number when it is appended. Items are
+ * discarded from the tail, so readers can keep their position as an absolute sequence number
+ * while the storage wraps around. A plain ring_buffer_base holds no items: it only keeps the
+ * capacity and the sequence numbers of a ring buffer whose item type is not known yet.
+ *
+ * Ring buffers allow one writer at a time. The head and the tail are atomic: an item published by
+ * emplace_back can be read by other threads as soon as they observe the new head, provided that its
+ * slot is not discarded while they read it.
+ *
+ * The slots are allocated from a memory resource, which also allocates the memory of the items that use a
+ * polymorphic allocator, such as std::pmr::string. Items may be discarded by a thread while another one
+ * appends items, so the resource must be thread-safe.
+ */
+class ring_buffer_base
+{
+public:
+    /**
+     * @brief           Constructor
+     *
+     * @param capacity  The maximum number of items retained at the same time.
+     * @param sequence  The sequence number of the first item.
+     * @param resource  The memory resource of the slots and of the items.
+     * @param placement How the slots are allocated.
+     */
+    explicit ring_buffer_base(size_t capacity = 0, uint64_t sequence = 0,
+                              std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                              ring_buffer_placement placement = {})
+        : m_resource(resource), m_placement(placement), m_head(sequence), m_tail(sequence)
+    {
+        set_capacity(capacity);
+    }
+
+    ring_buffer_base(const ring_buffer_base&) = delete;
+    ring_buffer_base& operator=(const ring_buffer_base&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    virtual ~ring_buffer_base() = default;
+
+    /**
+     * @brief           Discard all the items with a sequence number lower than the given one.
+     *
+     * @param sequence  The sequence number of the first item to be retained.
+     */
+    virtual void discard_until([[maybe_unused]] uint64_t sequence) {}
+
+    /**
+     * @brief           Change the capacity of the ring buffer.
+     *
+     * @param capacity  The new capacity.
+     * @note            If the ring buffer holds more items than the new capacity, the oldest ones are discarded.
+     */
+    virtual void resize(size_t capacity)
+    {
+        set_capacity(capacity);
+    }
+
+    /**
+     * @brief           Discard all the items. Sequence numbers keep increasing from the current head.
+     */
+    void clear()
+    {
+        discard_until(head());
+    }
+
+    /**
+     * @brief           Return the sequence number that the next appended item will get.
+     */
+    uint64_t head() const { return m_head_ref->load(std::memory_order_acquire); }
+
+    /**
+     * @brief           Return the sequence number of the oldest retained item.
+     */
+    uint64_t tail() const { return m_tail_ref->load(std::memory_order_acquire); }
+
+    /**
+     * @brief           Return the maximum number of items retained at the same time.
+     */
+    size_t capacity() const { return m_capacity; }
+
+    /**
+     * @brief           Return the memory resource of the slots and of the items.
+     */
+    std::pmr::memory_resource* resource() const { return m_resource; }
+
+    /**
+     * @brief           Return how the slots are allocated.
+     */
+    const ring_buffer_placement& placement() const { return m_placement; }
+
+    /**
+     * @brief           Return the number of retained items.
+     */
+    size_t size() const { return static_cast<size_t>(head() - tail()); }
+
+    /**
+     * @brief           Check if the ring buffer holds no items.
+     */
+    bool empty() const { return head() == tail(); }
+
+    /**
+     * @brief           Check if there is no free slot left.
+     */
+    bool full() const { return size() >= m_capacity; }
+
+protected:
+    /**
+     * @brief           Set the number of slots, rounded up to a power of two if the placement says so.
+     *
+     * @param capacity  The number of slots.
+     */
+    void set_capacity(size_t capacity)
+    {
+        m_capacity = m_placement.power_of_two && capacity > 0 ? std::bit_ceil(capacity) : capacity;
+        m_mask = std::has_single_bit(m_capacity) ? m_capacity - 1 : 0;
+    }
+
+    /**
+     * @brief           Return the slot of a sequence number, masking it rather than dividing it when the number
+     *                  of slots is a power of two.
+     *
+     * @param sequence  The sequence number.
+     */
+    size_t offset(uint64_t sequence) const
+    {
+        return static_cast<size_t>(m_mask != 0 ? sequence & m_mask : sequence % m_capacity);
+    }
+
+    // The number of slots
+    size_t m_capacity = 0;
+    // The number of slots minus one when it is a power of two greater than one, 0 otherwise
+    size_t m_mask = 0;
+    // The memory resource of the slots and of the items
+    std::pmr::memory_resource* m_resource;
+    // How the slots are allocated
+    ring_buffer_placement m_placement;
+    // The sequence numbers of the next and of the oldest item, which are kept in the file of mapped slots
+    std::atomic<uint64_t>* m_head_ref = &m_head;
+    std::atomic<uint64_t>* m_tail_ref = &m_tail;
+    // The sequence number of the next item, which the writer moves on its own cache line
+    alignas(DATA_PIT_CACHE_LINE_SIZE) std::atomic<uint64_t> m_head;
+    // The sequence number of the oldest item, which the writer moves as the readers release items
+    alignas(DATA_PIT_CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail;
+};
+
+/**
+ * @brief A bounded ring buffer storing its items in a contiguous block of slots.
+ *
+ * The slots are either allocated from the memory resource, or mapped from a file for trivially copyable items, in
+ * which case the sequence numbers are kept in the file as well and the capacity cannot change. Mapped slots can be
+ * shared by the ring buffers of several processes, one of which writes.
+ *
+ * @tparam T The item type.
+ */
+template <typename T>
+class ring_buffer final : public ring_buffer_base
+{
+public:
+    /**
+     * @brief           Constructor
+     *
+     * @param capacity  The maximum number of items retained at the same time.
+     * @param sequence  The sequence number of the first item.
+     * @param resource  The memory resource of the slots and of the items.
+     * @param placement How the slots are allocated.
+     */
+    explicit ring_buffer(size_t capacity = 0, uint64_t sequence = 0,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+                         ring_buffer_placement placement = {})
+        : ring_buffer_base(capacity, sequence, resource, placement), m_slots(allocate(m_capacity)) {}
+
+    /**
+     * @brief           Constructor of a ring buffer whose slots are mapped from a file
+     *
+     * @param mapping   The mapped slots, which must hold items of the size and alignment of T.
+     * @note            The items and the sequence numbers are left in the file when the ring buffer is destroyed.
+     */
+    explicit ring_buffer(std::unique_ptr<mapped_ring> mapping) requires std::is_trivially_copyable_v<T>
+        : ring_buffer_base(mapping->header().capacity), m_slots(static_cast<T*>(mapping->slots())),
+          m_mapping(std::move(mapping))
+    {
+        m_head_ref = &m_mapping->header().head;
+        m_tail_ref = &m_mapping->header().tail;
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~ring_buffer() override
+    {
+        if (m_mapping != nullptr) return;
+        clear();
+        deallocate(m_slots, m_capacity);
+    }
+
+    /**
+     * @brief           Construct a new item at the head of the ring buffer.
+     *
+     * @param args      The arguments forwarded to the constructor of the item.
+     * @return          The new item.
+     * @note            The ring buffer must not be full.
+     */
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        auto head = m_head_ref->load(std::memory_order_relaxed);
+        T* item = construct(slot(head), std::forward<Args>(args)...);
+        m_head_ref->store(head + 1, std::memory_order_release);
+        return *item;
+    }
+
+    /**
+     * @brief           Append a range of items at the head of the ring buffer, publishing them all at once.
+     *
+     * @param first     The first item of the range.
+     * @param last      The end of the range.
+     * @note            The ring buffer must have enough free slots for the whole range.
+     */
+    template <typename InputIt>
+    void append(InputIt first, InputIt last)
+    {
+        auto head = m_head_ref->load(std::memory_order_relaxed);
+        auto sequence = head;
+        try
+        {
+            for (; first != last; ++first, ++sequence)
+            {
+                construct(slot(sequence), *first);
+            }
+        }
+        catch (...)
+        {
+            // Destroy the items constructed so far, since they were never published
+            for (; sequence != head; --sequence)
+            {
+                std::destroy_at(slot(sequence - 1));
+            }
+            throw;
+        }
+        m_head_ref->store(sequence, std::memory_order_release);
+    }
+
+    /**
+     * @brief           Discard the oldest item.
+     *
+     * @note            The ring buffer must not be empty.
+     */
+    void pop_front()
+    {
+        auto tail = m_tail_ref->load(std::memory_order_relaxed);
+        std::destroy_at(slot(tail));
+        m_tail_ref->store(tail + 1, std::memory_order_release);
+    }
+
+    void discard_until(uint64_t sequence) override
+    {
+        auto head = m_head_ref->load(std::memory_order_relaxed);
+        while (m_tail_ref->load(std::memory_order_relaxed) < std::min(sequence, head))
+        {
+            pop_front();
+        }
+    }
+
+    void resize(size_t capacity) override
+    {
+        if (m_placement.power_of_two && capacity > 0) capacity = std::bit_ceil(capacity);
+        if (capacity == m_capacity || m_mapping != nullptr) return;
+
+        // Drop the items that would not fit in the new storage
+        if (size() > capacity) discard_until(head() - capacity);
+
+        // Move the retained items to the new storage, keeping their sequence numbers
+        T* slots = allocate(capacity);
+        for (auto sequence = tail(); sequence < head(); ++sequence)
+        {
+            construct(slots + sequence % capacity, std::move(*slot(sequence)));
+            std::destroy_at(slot(sequence));
+        }
+
+        deallocate(m_slots, m_capacity);
+        m_slots = slots;
+        set_capacity(capacity);
+    }
+
+    /**
+     * @brief           Return a reference to the item with the given sequence number.
+     *
+     * @param sequence  The sequence number, which must be in the range [tail(), head()).
+     * @return          The item.
+     */
+    T& at(uint64_t sequence)
+    {
+        return *slot(sequence);
+    }
+
+    /**
+     * @brief           Copy a range of items, which are stored in at most two contiguous blocks of slots.
+     *
+     * @param sequence  The sequence number of the first item, which must be retained.
+     * @param count     The number of items, which must all be retained.
+     * @param out       The destination of the copy.
+     * @return          The end of the destination range.
+     */
+    template <typename OutputIt>
+    OutputIt copy(uint64_t sequence, size_t count, OutputIt out)
+    {
+        auto first = offset(sequence);
+        auto first_block = std::min(count, m_capacity - first);
+        out = std::copy_n(m_slots + first, first_block, out);
+        return std::copy_n(m_slots, count - first_block, out);
+    }
+
+    /**
+     * @brief           Return the contiguous block of slots holding the first items of a range.
+     *
+     * @param sequence  The sequence number of the first item, which must be retained.
+     * @param end       The sequence number past the last item, which must all be retained.
+     * @return          The items from sequence up to end or up to the last slot, whichever comes first.
+     */
+    std::span<T> block(uint64_t sequence, uint64_t end)
+    {
+        auto first = offset(sequence);
+        return {m_slots + first, static_cast<size_t>(std::min<uint64_t>(end - sequence, m_capacity - first))};
+    }
+
+    /**
+     * @brief           Find the first item of a range for which a predicate gives the expected result.
+     *
+     * @param sequence  The sequence number of the first item, which must be retained.
+     * @param end       The sequence number past the last item, which must all be retained.
+     * @param predicate The predicate, called on the items in place.
+     * @param expected  The result of the predicate looked for.
+     * @return          The sequence number of the item found, or end if there is none.
+     * @note            The predicate is evaluated on blocks of contiguous items without branching, so that simple
+     *                  predicates are vectorized, and may be evaluated on some items after the one found.
+     */
+    template <typename Predicate>
+    uint64_t find_if(uint64_t sequence, uint64_t end, Predicate& predicate, bool expected = true)
+    {
+        while (sequence < end)
+        {
+            // Gather the results of a block of up to 64 items in a mask, then look for the first one expected
+            auto first = offset(sequence);
+            auto count = static_cast<size_t>(std::min<uint64_t>({end - sequence, m_capacity - first, 64}));
+            const T* items = m_slots + first;
+            uint64_t results = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                results |= static_cast<uint64_t>(static_cast<bool>(predicate(items[i]))) << i;
+            }
+
+            if (!expected) results = ~results & (count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1);
+            if (results != 0) return sequence + std::countr_zero(results);
+            sequence += count;
+        }
+        return end;
+    }
+
+    /**
+     * @brief           Return the file the slots are mapped from, or nullptr if they are allocated.
+     */
+    mapped_ring* mapping() const { return m_mapping.get(); }
+
+private:
+    inline T* slot(uint64_t sequence)
+    {
+        return m_slots + offset(sequence);
+    }
+
+    // Construct an item, passing the memory resource to it if it uses a polymorphic allocator
+    template <typename... Args>
+    T* construct(T* slot, Args&&... args)
+    {
+        return std::uninitialized_construct_using_allocator(slot, std::pmr::polymorphic_allocator<T>(m_resource),
+                                                            std::forward<Args>(args)...);
+    }
+
+    T* allocate(size_t capacity)
+    {
+        if (capacity == 0) return nullptr;
+        if (m_placement.numa_node < 0 && !m_placement.prefault)
+        {
+            return std::pmr::polymorphic_allocator<T>(m_resource).allocate(capacity);
+        }
+
+        // The slots bound to a node take whole pages, so that no other data share their policy
+        auto slots = m_resource->allocate(slots_bytes(capacity), slots_alignment());
+        place(slots, slots_bytes(capacity));
+        return static_cast<T*>(slots);
+    }
+
+    void deallocate(T* slots, size_t capacity)
+    {
+        if (slots == nullptr) return;
+        if (m_placement.numa_node < 0 && !m_placement.prefault)
+        {
+            std::pmr::polymorphic_allocator<T>(m_resource).deallocate(slots, capacity);
+            return;
+        }
+        m_resource->deallocate(slots, slots_bytes(capacity), slots_alignment());
+    }
+
+    // The size of the storage of the slots, in whole pages if they are bound to a node
+    size_t slots_bytes(size_t capacity) const
+    {
+        auto bytes = capacity * sizeof(T);
+        if (m_placement.numa_node < 0) return bytes;
+        return (bytes + page_size() - 1) / page_size() * page_size();
+    }
+
+    // The alignment of the storage of the slots, a page if they are bound to a node
+    size_t slots_alignment() const
+    {
+        return m_placement.numa_node < 0 ? alignof(T) : std::max(alignof(T), page_size());
+    }
+
+    // Bind the pages of the slots to their node, then touch them so that they are mapped before being used
+    void place([[maybe_unused]] void* slots, size_t bytes)
+    {
+#if defined(__linux__)
+        // The node is a preference, so the slots are still allocated if the node is full or missing
+        if (m_placement.numa_node >= 0 && m_placement.numa_node < 1024)
+        {
+            unsigned long nodes[1024 / (8 * sizeof(unsigned long))] = {};
+            auto node = static_cast<size_t>(m_placement.numa_node);
+            nodes[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+            syscall(SYS_mbind, slots, bytes, MPOL_PREFERRED, nodes, 1024 + 1, MPOL_MF_MOVE);
+        }
+#endif
+        if (m_placement.prefault) std::memset(slots, 0, bytes);
+    }
+
+    // The size of the pages the slots bound to a node are aligned to
+    static size_t page_size()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+#else
+        return 4096;
+#endif
+    }
+
+    // The storage for the items
+    T* m_slots;
+    // The file the slots are mapped from, if any
+    std::unique_ptr<mapped_ring> m_mapping;
+};
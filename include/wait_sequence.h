@@ -0,0 +1,199 @@
+/*
+ *  wait_sequence.h
+ *  data_pit
+ *
+ *  Copyright (c) 2024 Salvatore Rivieccio. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/**
+ * @brief A sequence counter that threads can wait on until it changes.
+ *
+ * A waiter reads the sequence, checks the condition it waits for, and if the condition does not hold waits for
+ * the sequence to move past the value it read. A notifier makes the condition hold, then advances the sequence.
+ * Since the waiter compares the sequence before sleeping, a notification sent after it checked the condition is
+ * never lost.
+ *
+ * Notifying costs a single atomic increment while nobody waits. On Linux, waiters sleep on a futex on the sequence
+ * itself, so waking them up does not make them contend on a mutex. A sequence in memory shared by several processes
+ * must be made process-shared, which only Linux supports.
+ */
+class wait_sequence
+{
+public:
+    /**
+     * @brief           Constructor
+     *
+     * @param process_shared Whether the sequence is waited on and notified by several processes.
+     */
+    explicit wait_sequence(bool process_shared = false)
+#if defined(__linux__)
+        : m_wait_op(process_shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE),
+          m_wake_op(process_shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE)
+#endif
+    {
+        (void)process_shared;
+    }
+
+    wait_sequence(const wait_sequence&) = delete;
+    wait_sequence& operator=(const wait_sequence&) = delete;
+
+    /**
+     * @brief           Return the current value of the sequence, which must be read before checking the condition.
+     */
+    uint32_t load() const { return m_sequence.load(std::memory_order_seq_cst); }
+
+    /**
+     * @brief           Wait until the sequence moves past a value, or a deadline expires.
+     *
+     * @param expected  The value of the sequence read before checking the condition.
+     * @param deadline  The time at which the wait expires.
+     * @return          False if the deadline expired, true otherwise. The condition must be checked again.
+     */
+    bool wait_until(uint32_t expected, std::chrono::steady_clock::time_point deadline)
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        auto woken = wait_for_change(expected, deadline);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        return woken;
+    }
+
+    /**
+     * @brief           Spin until the sequence moves past a value, a number of iterations elapses,
+     *                  or a deadline expires.
+     *
+     * @param expected  The value of the sequence read before checking the condition.
+     * @param deadline  The time at which the wait expires.
+     * @param spins     The maximum number of iterations.
+     * @return          True if the sequence moved past the value, false otherwise.
+     * @note            A spinning thread is not a waiter, so it does not make notifying more expensive.
+     */
+    bool spin_until(uint32_t expected, std::chrono::steady_clock::time_point deadline,
+                    uint64_t spins = UINT64_MAX) const
+    {
+        for (uint64_t spin = 0; spin < spins; ++spin)
+        {
+            if (m_sequence.load(std::memory_order_acquire) != expected) return true;
+
+            // Reading the clock costs more than an iteration, so it is only read once in a while
+            if (spin % 64 == 63 && std::chrono::steady_clock::now() >= deadline) return false;
+            cpu_relax();
+        }
+        return m_sequence.load(std::memory_order_acquire) != expected;
+    }
+
+    /**
+     * @brief           Advance the sequence, waking up all the waiting threads.
+     */
+    void notify_all()
+    {
+        m_sequence.fetch_add(1, std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_seq_cst) == 0) return;
+
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_sequence), m_wake_op, INT_MAX, nullptr, nullptr, 0);
+#else
+        // Lock the mutex so that a waiter cannot miss the notification between its check and its wait
+        { std::lock_guard lock(m_mutex); }
+        m_cv.notify_all();
+#endif
+    }
+
+private:
+    static void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    bool wait_for_change(uint32_t expected, std::chrono::steady_clock::time_point deadline)
+    {
+#if defined(__linux__)
+        while (m_sequence.load(std::memory_order_acquire) == expected)
+        {
+            auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::steady_clock::duration::zero()) return false;
+
+            // The futex waits on the monotonic clock, as steady_clock does
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            timespec timeout{};
+            timeout.tv_sec = static_cast<time_t>(seconds.count());
+            timeout.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds).count());
+            if (syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_sequence), m_wait_op, expected,
+                        &timeout, nullptr, 0) == -1 && errno == ETIMEDOUT)
+            {
+                return m_sequence.load(std::memory_order_acquire) != expected;
+            }
+        }
+        return true;
+#else
+        std::unique_lock lock(m_mutex);
+        return m_cv.wait_until(lock, deadline, [&]()
+        {
+            return m_sequence.load(std::memory_order_acquire) != expected;
+        });
+#endif
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the sequence must be usable as a futex");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "the sequence must be usable as a futex");
+
+    // The sequence
+    std::atomic<uint32_t> m_sequence{0};
+    // The number of waiting threads
+    std::atomic<uint32_t> m_waiters{0};
+#if defined(__linux__)
+    // The futex operations, which are private to the process unless the sequence is process-shared
+    int m_wait_op;
+    int m_wake_op;
+#else
+    // The mutex of the condition variable
+    std::mutex m_mutex;
+    // The condition variable the waiting threads sleep on
+    std::condition_variable m_cv;
+#endif
+};
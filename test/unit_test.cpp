@@ -26,7 +26,26 @@
 #include <thread>
 #include <atomic>
 #include <list>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <memory_resource>
+#include <coroutine>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 #include <data_pit.h>
+#include <data_pit_bridge.h>
+#include <data_pit_static.h>
 
 enum queue_id
 {
@@ -297,6 +316,74 @@ TEST(data_pit, test_set_queue_size)
     ASSERT_FALSE(result.has_value());
 }
 
+TEST(data_pit, test_reclaim_consumed_slots)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 10);
+    auto consumer_id = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+        auto result = dp.consume<int>(consumer_id);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+}
+
+TEST(data_pit, test_slowest_consumer_holds_slots)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 10);
+    auto fast_consumer = dp.register_consumer(queue_1);
+    auto slow_consumer = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+        ASSERT_TRUE(dp.consume<int>(fast_consumer).has_value());
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 10));
+
+    // consume 5 messages with the slow consumer to free 5 slots
+    for(auto i = 0; i < 5; ++i)
+    {
+        auto result = dp.consume<int>(slow_consumer);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+    for(auto i = 10; i < 15; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 15));
+
+    // the slow consumer still reads every message in order
+    for(auto i = 5; i < 15; ++i)
+    {
+        auto result = dp.consume<int>(slow_consumer);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+}
+
+TEST(data_pit, test_unregister_consumer_frees_slots)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 10);
+    auto consumer_id = dp.register_consumer(queue_1);
+    auto idle_consumer = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+        ASSERT_TRUE(dp.consume<int>(consumer_id).has_value());
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 10));
+    dp.unregister_consumer(idle_consumer);
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 10));
+    auto result = dp.consume<int>(consumer_id);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(10, result.value());
+}
+
 TEST(data_pit, test_clear_queue)
 {
     data_pit dp;
@@ -465,6 +552,2101 @@ TEST(data_pit, complex_object)
     ASSERT_EQ(obj.c, result.value().c);
 }
 
+TEST(data_pit, test_channel_produce_consume)
+{
+    data_pit dp;
+    auto channel = dp.channel<int>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    ASSERT_EQ(queue_1, channel->queue_id());
+    auto consumer_id = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, channel->produce(i));
+    }
+    for(auto i = 0; i < 5; ++i)
+    {
+        auto result = channel->consume(consumer_id);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+    // channels and the untyped interface share the same queue
+    for(auto i = 5; i < 10; ++i)
+    {
+        auto result = dp.consume<int>(consumer_id);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+    ASSERT_FALSE(channel->consume(consumer_id).has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(consumer_id));
+}
+
+TEST(data_pit, test_channel_type_mismatch)
+{
+    data_pit dp;
+    dp.produce(queue_1, 42);
+    ASSERT_FALSE(dp.channel<float>(queue_1).has_value());
+    ASSERT_TRUE(dp.channel<int>(queue_1).has_value());
+
+    // a channel fixes the type of the queue even when it holds no data
+    auto channel = dp.channel<int>(queue_2);
+    ASSERT_TRUE(channel.has_value());
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(queue_2, 3.14f));
+    dp.clear_all_queues();
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(queue_2, 3.14f));
+    ASSERT_EQ(data_pit_result::success, channel->produce(42));
+}
+
+TEST(data_pit, test_channel_wrong_queue)
+{
+    data_pit dp;
+    auto channel = dp.channel<int>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    auto consumer_id = dp.register_consumer(queue_2);
+    channel->produce(42);
+    ASSERT_FALSE(channel->consume(consumer_id).has_value());
+    ASSERT_FALSE(channel->consume(consumer_id + 1).has_value());
+}
+
+TEST(data_pit, test_channel_blocking)
+{
+    struct large_object
+    {
+        int id;
+        char payload[196];
+    };
+
+    data_pit dp;
+    auto channel = dp.channel<large_object>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    auto consumer_id = dp.register_consumer(queue_1);
+
+    std::thread t([&channel, consumer_id]()
+    {
+        for(auto i = 0; i < 100; ++i)
+        {
+            auto result = channel->consume(consumer_id, true, 1000);
+            ASSERT_TRUE(result.has_value());
+            ASSERT_EQ(i, result->id);
+        }
+    });
+
+    for(auto i = 0; i < 100; ++i)
+    {
+        large_object obj{};
+        obj.id = i;
+        while(channel->produce(obj) == data_pit_result::queue_is_full)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    t.join();
+}
+
+TEST(data_pit, test_create_queue)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 10));
+    ASSERT_EQ(data_pit_result::queue_already_exists, dp.create_queue(queue_1, data_pit_queue_mode::multi_producer));
+    dp.produce(queue_2, 42);
+    ASSERT_EQ(data_pit_result::queue_already_exists, dp.create_queue(queue_2, data_pit_queue_mode::single_producer));
+
+    auto consumer_id = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 10));
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(queue_1, 3.14f));
+    for(auto i = 0; i < 10; ++i)
+    {
+        auto result = dp.consume<int>(consumer_id);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+    ASSERT_FALSE(dp.consume<int>(consumer_id).has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(consumer_id));
+    ASSERT_FALSE(dp.consume<int>(consumer_id, true, 100).has_value());
+    ASSERT_EQ(data_pit_result::timeout_expired, dp.get_last_error(consumer_id));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 10));
+}
+
+TEST(data_pit, test_single_producer_clear_and_reset)
+{
+    data_pit dp;
+    dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 10);
+    auto consumer_id = dp.register_consumer(queue_1);
+    for(auto i = 0; i < 5; ++i)
+    {
+        dp.produce(queue_1, i);
+    }
+    ASSERT_EQ(0, dp.consume<int>(consumer_id).value());
+    ASSERT_EQ(1, dp.consume<int>(consumer_id).value());
+    dp.reset_consumer(consumer_id);
+    ASSERT_EQ(0, dp.consume<int>(consumer_id).value());
+
+    dp.clear_queue(queue_1);
+    ASSERT_FALSE(dp.consume<int>(consumer_id).has_value());
+    for(auto i = 5; i < 15; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    for(auto i = 5; i < 15; ++i)
+    {
+        auto result = dp.consume<int>(consumer_id);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(i, result.value());
+    }
+}
+
+TEST(data_pit, test_single_producer_multi_consumers)
+{
+    constexpr int items = 10000;
+    data_pit dp;
+    dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 16);
+    auto channel = dp.channel<int>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+
+    std::list<unsigned int> consumer_ids;
+    for(auto i = 0; i < 4; ++i)
+    {
+        consumer_ids.push_back(dp.register_consumer(queue_1));
+    }
+
+    std::list<std::thread> threads;
+    for(auto consumer_id : consumer_ids)
+    {
+        threads.emplace_back([&channel, consumer_id]()
+        {
+            for(auto i = 0; i < items; ++i)
+            {
+                auto result = channel->consume(consumer_id, true, 5000);
+                ASSERT_TRUE(result.has_value());
+                ASSERT_EQ(i, result.value());
+            }
+        });
+    }
+    threads.emplace_back([&channel]()
+    {
+        for(auto i = 0; i < items; ++i)
+        {
+            while(channel->produce(i) == data_pit_result::queue_is_full)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+}
+
+TEST(data_pit, test_concurrent_registration)
+{
+    data_pit dp;
+    std::list<std::thread> threads;
+    for(auto i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&dp, i]()
+        {
+            for(auto j = 0; j < 200; ++j)
+            {
+                auto consumer_id = dp.register_consumer(i);
+                ASSERT_NE(0, consumer_id);
+                ASSERT_EQ(data_pit_result::success, dp.produce(i, j));
+                auto result = dp.consume<int>(consumer_id);
+                ASSERT_TRUE(result.has_value());
+                dp.unregister_consumer(consumer_id);
+            }
+        });
+    }
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+
+    // every consumer ID has been released, so none of them has leaked
+    auto consumer_id = dp.register_consumer(queue_1);
+    ASSERT_LE(consumer_id, 8u);
+}
+
+TEST(data_pit, test_bulk_produce_consume)
+{
+    data_pit dp;
+    auto consumer_id = dp.register_consumer(queue_1);
+    std::vector<int> data = {1, 2, 3, 4, 5};
+    ASSERT_EQ(data_pit_result::success, dp.produce_bulk<int>(queue_1, data));
+
+    std::vector<int> result;
+    ASSERT_EQ(3, dp.consume_bulk<int>(consumer_id, std::back_inserter(result), 3));
+    ASSERT_EQ(2, dp.consume_bulk<int>(consumer_id, std::back_inserter(result), 3));
+    ASSERT_EQ(0, dp.consume_bulk<int>(consumer_id, std::back_inserter(result), 3));
+    ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(consumer_id));
+    ASSERT_EQ(data, result);
+
+    // a bulk consume of another type reports a type mismatch
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 6));
+    std::vector<double> wrong;
+    ASSERT_EQ(0, dp.consume_bulk<double>(consumer_id, std::back_inserter(wrong), 3));
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.get_last_error(consumer_id));
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.produce_bulk<double>(queue_1, std::vector<double>{1.0}));
+}
+
+TEST(data_pit, test_bulk_produce_all_or_nothing)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 4);
+    auto consumer_id = dp.register_consumer(queue_1);
+    ASSERT_EQ(data_pit_result::success, dp.produce_bulk<int>(queue_1, std::vector<int>{1, 2, 3}));
+
+    // the batch does not fit, so none of it is produced
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce_bulk<int>(queue_1, std::vector<int>{4, 5}));
+    std::vector<int> result;
+    ASSERT_EQ(3, dp.consume_bulk<int>(consumer_id, std::back_inserter(result), 10));
+    ASSERT_EQ((std::vector<int>{1, 2, 3}), result);
+
+    // the consumed slots are reclaimed, and the batch wraps around the ring
+    ASSERT_EQ(data_pit_result::success, dp.produce_bulk<int>(queue_1, std::vector<int>{4, 5, 6, 7}));
+    result.clear();
+    ASSERT_EQ(4, dp.consume_bulk<int>(consumer_id, std::back_inserter(result), 10));
+    ASSERT_EQ((std::vector<int>{4, 5, 6, 7}), result);
+}
+
+TEST(data_pit, test_bulk_single_producer)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 64));
+    auto channel = dp.channel<int>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    auto consumer_id = dp.register_consumer(queue_1);
+
+    const int batches = 1000;
+    std::thread producer([&channel]()
+    {
+        for(auto i = 0; i < batches; ++i)
+        {
+            std::vector<int> batch = {i * 4, i * 4 + 1, i * 4 + 2, i * 4 + 3};
+            while(channel->produce_bulk(batch) != data_pit_result::success)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<int> result;
+    while(result.size() < batches * 4)
+    {
+        channel->consume_bulk(consumer_id, std::back_inserter(result), 16, true, 1000);
+    }
+    producer.join();
+    for(auto i = 0; i < batches * 4; ++i)
+    {
+        ASSERT_EQ(i, result[i]);
+    }
+}
+
+struct copy_counter
+{
+    static inline std::atomic<int> copies = 0;
+
+    explicit copy_counter(int v) : value(v) {}
+    copy_counter(const copy_counter& other) : value(other.value) { ++copies; }
+    copy_counter(copy_counter&& other) noexcept : value(other.value) {}
+    copy_counter& operator=(const copy_counter&) = delete;
+    copy_counter& operator=(copy_counter&&) = delete;
+
+    int value;
+};
+
+TEST(data_pit, test_produce_move_and_emplace)
+{
+    data_pit dp;
+    copy_counter::copies = 0;
+    auto consumer_id = dp.register_consumer(queue_1);
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, copy_counter(1)));
+    ASSERT_EQ(data_pit_result::success, dp.emplace<copy_counter>(queue_1, 2));
+
+    // the last consumer of the data moves it out
+    auto first = dp.consume_move<copy_counter>(consumer_id);
+    auto second = dp.consume_move<copy_counter>(consumer_id);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(1, first->value);
+    ASSERT_EQ(2, second->value);
+    ASSERT_EQ(0, copy_counter::copies);
+
+    // data moved out are no longer retained
+    dp.reset_consumer(consumer_id);
+    ASSERT_FALSE(dp.consume_move<copy_counter>(consumer_id).has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(consumer_id));
+
+    // an rvalue is left untouched if it is not produced
+    ASSERT_EQ(data_pit_result::success, dp.emplace<copy_counter>(queue_1, 3));
+    std::vector<int> data = {1, 2, 3};
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(queue_1, std::move(data)));
+    ASSERT_EQ(3, data.size());
+}
+
+TEST(data_pit, test_consume_move_multi_consumers)
+{
+    data_pit dp;
+    copy_counter::copies = 0;
+    auto consumer_1 = dp.register_consumer(queue_1);
+    auto consumer_2 = dp.register_consumer(queue_1);
+    ASSERT_EQ(data_pit_result::success, dp.emplace<copy_counter>(queue_1, 1));
+
+    // the first consumer copies the data, since the second one still needs it
+    auto copied = dp.consume_move<copy_counter>(consumer_1);
+    ASSERT_TRUE(copied.has_value());
+    ASSERT_EQ(1, copy_counter::copies);
+    auto moved = dp.consume_move<copy_counter>(consumer_2);
+    ASSERT_TRUE(moved.has_value());
+    ASSERT_EQ(1, moved->value);
+    ASSERT_EQ(1, copy_counter::copies);
+
+    // consumers registered later do not see the data moved out
+    auto consumer_3 = dp.register_consumer(queue_1);
+    ASSERT_FALSE(dp.consume_move<copy_counter>(consumer_3).has_value());
+}
+
+TEST(data_pit, test_consume_move_single_producer)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 16));
+    auto channel = dp.channel<std::vector<int>>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    auto consumer_id = dp.register_consumer(queue_1);
+
+    const int count = 10000;
+    std::thread producer([&channel]()
+    {
+        for(auto i = 0; i < count; ++i)
+        {
+            while(channel->emplace(1, i) != data_pit_result::success)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for(auto i = 0; i < count; ++i)
+    {
+        auto result = channel->consume_move(consumer_id, true, 1000);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(std::vector<int>(1, i), *result);
+    }
+    producer.join();
+}
+
+TEST(data_pit, test_consume_view_multi_consumers)
+{
+    data_pit dp;
+    copy_counter::copies = 0;
+    auto consumer_1 = dp.register_consumer(queue_1);
+    auto consumer_2 = dp.register_consumer(queue_1);
+    ASSERT_EQ(data_pit_result::success, dp.emplace<copy_counter>(queue_1, 1));
+
+    // every consumer views the same data, which is never copied
+    auto view_1 = dp.consume_view<copy_counter>(consumer_1);
+    auto view_2 = dp.consume_view<copy_counter>(consumer_2);
+    ASSERT_TRUE(view_1.has_value());
+    ASSERT_TRUE(view_2.has_value());
+    ASSERT_EQ(1, (*view_1)->value);
+    ASSERT_EQ(&**view_1, &**view_2);
+    ASSERT_EQ(0, copy_counter::copies);
+
+    ASSERT_FALSE(dp.consume_view<copy_counter>(consumer_1).has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(consumer_1));
+    ASSERT_FALSE(dp.consume_view<double>(consumer_1).has_value());
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.get_last_error(consumer_1));
+}
+
+TEST(data_pit, test_consume_view_holds_slot)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 2);
+    auto consumer_id = dp.register_consumer(queue_1);
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 1));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 2));
+
+    // the viewed slot is not reclaimed, nor discarded by clearing the queue
+    auto view = dp.consume_view<int>(consumer_id);
+    ASSERT_TRUE(view.has_value());
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 3));
+    dp.clear_queue(queue_1);
+    ASSERT_EQ(1, **view);
+    ASSERT_FALSE(dp.consume<int>(consumer_id).has_value());
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 3));
+
+    // once released, the slots are reclaimed
+    view->release();
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 3));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 4));
+    ASSERT_EQ(3, dp.consume<int>(consumer_id).value());
+
+    // consuming again releases the viewed data as well
+    view = dp.consume_view<int>(consumer_id);
+    ASSERT_TRUE(view.has_value());
+    ASSERT_EQ(4, **view);
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 5));
+    ASSERT_EQ(5, dp.consume<int>(consumer_id).value());
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 6));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 7));
+}
+
+TEST(data_pit, test_consume_view_single_producer)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 8));
+    auto channel = dp.channel<std::vector<int>>(queue_1);
+    ASSERT_TRUE(channel.has_value());
+    auto consumer_1 = dp.register_consumer(queue_1);
+    auto consumer_2 = dp.register_consumer(queue_1);
+
+    const int count = 10000;
+    std::thread producer([&channel]()
+    {
+        for(auto i = 0; i < count; ++i)
+        {
+            while(channel->emplace(4, i) != data_pit_result::success)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::list<std::thread> consumers;
+    for(auto consumer_id : {consumer_1, consumer_2})
+    {
+        consumers.emplace_back([&channel, consumer_id]()
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                auto view = channel->consume_view(consumer_id, true, 1000);
+                ASSERT_TRUE(view.has_value());
+                ASSERT_EQ(std::vector<int>(4, i), **view);
+            }
+        });
+    }
+    producer.join();
+    for(auto &t : consumers)
+    {
+        t.join();
+    }
+}
+
+TEST(data_pit, test_wake_blocked_consumers)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, mode));
+        const int consumers_count = 32;
+        const int count = 100;
+        std::atomic<int> received = 0;
+        std::list<std::thread> consumers;
+        for(auto i = 0; i < consumers_count; ++i)
+        {
+            auto consumer_id = dp.register_consumer(queue_1);
+            consumers.emplace_back([&dp, &received, consumer_id]()
+            {
+                for(auto j = 0; j < count; ++j)
+                {
+                    auto result = dp.consume<int>(consumer_id, true, 5000);
+                    ASSERT_TRUE(result.has_value());
+                    ASSERT_EQ(j, result.value());
+                    ++received;
+                }
+            });
+        }
+
+        // every consumer is woken up by every data produced
+        for(auto j = 0; j < count; ++j)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, j));
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        for(auto &t : consumers)
+        {
+            t.join();
+        }
+        ASSERT_EQ(consumers_count * count, received);
+    }
+}
+
+TEST(data_pit, test_wait_sequence)
+{
+    wait_sequence signal;
+
+    // waiting for a sequence that already moved on returns at once
+    auto sequence = signal.load();
+    signal.notify_all();
+    ASSERT_TRUE(signal.wait_until(sequence, std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+
+    // otherwise the wait expires
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(signal.wait_until(signal.load(), start + std::chrono::milliseconds(20)));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    // a notification wakes up the waiting thread
+    std::atomic<bool> woken = false;
+    sequence = signal.load();
+    std::thread waiter([&]()
+    {
+        woken = signal.wait_until(sequence, std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    signal.notify_all();
+    waiter.join();
+    ASSERT_TRUE(woken);
+}
+
+TEST(data_pit, test_wait_policies)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        for(auto policy : {data_pit_wait_policy::block, data_pit_wait_policy::spin_then_block,
+                           data_pit_wait_policy::spin})
+        {
+            data_pit dp;
+            ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, mode));
+            auto consumer_id = dp.register_consumer(queue_1);
+            ASSERT_EQ(data_pit_result::success, dp.set_wait_policy(consumer_id, policy));
+
+            // the wait expires when no data are produced
+            auto start = std::chrono::steady_clock::now();
+            ASSERT_FALSE(dp.consume<int>(consumer_id, true, 20).has_value());
+            ASSERT_EQ(data_pit_result::timeout_expired, dp.get_last_error(consumer_id));
+            ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+            // otherwise the consumer gets the data
+            const int count = 200;
+            std::thread producer([&dp]()
+            {
+                for(auto i = 0; i < count; ++i)
+                {
+                    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+                    if(i % 10 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            });
+            for(auto i = 0; i < count; ++i)
+            {
+                auto result = dp.consume<int>(consumer_id, true, 5000);
+                ASSERT_TRUE(result.has_value());
+                ASSERT_EQ(i, result.value());
+            }
+            producer.join();
+        }
+    }
+
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::consumer_not_found, dp.set_wait_policy(1, data_pit_wait_policy::spin));
+}
+
+TEST(data_pit, test_consumer_group)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 4);
+    auto worker_1 = dp.register_consumer(queue_1, 1);
+    auto worker_2 = dp.register_consumer(queue_1, 1);
+    auto other_group = dp.register_consumer(queue_1, 2);
+    for(auto i = 0; i < 4; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+
+    // every data goes to only one consumer of the group
+    ASSERT_EQ(0, dp.consume<int>(worker_1).value());
+    ASSERT_EQ(1, dp.consume<int>(worker_2).value());
+    std::vector<int> result;
+    ASSERT_EQ(2, dp.consume_bulk<int>(worker_1, std::back_inserter(result), 10));
+    ASSERT_EQ((std::vector<int>{2, 3}), result);
+    ASSERT_FALSE(dp.consume<int>(worker_2).has_value());
+
+    // other groups still get every data
+    result.clear();
+    ASSERT_EQ(4, dp.consume_bulk<int>(other_group, std::back_inserter(result), 10));
+    ASSERT_EQ((std::vector<int>{0, 1, 2, 3}), result);
+
+    // the slots are reclaimed once claimed by a consumer of each group
+    for(auto i = 4; i < 8; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 8));
+
+    // a consumer joining a group starts from the position of the group
+    auto worker_3 = dp.register_consumer(queue_1, 1);
+    ASSERT_EQ(4, dp.consume<int>(worker_3).value());
+    ASSERT_EQ(5, dp.consume_move<int>(worker_1).value());
+}
+
+TEST(data_pit, test_consumer_group_parallel_drain)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, mode, 64));
+        const int workers_count = 4;
+        const int count = 20000;
+        std::vector<unsigned int> workers;
+        for(auto i = 0; i < workers_count; ++i)
+        {
+            workers.push_back(dp.register_consumer(queue_1, 0));
+        }
+
+        std::atomic<int> received = 0;
+        std::vector<std::vector<int>> results(workers_count);
+        std::list<std::thread> threads;
+        for(auto i = 0; i < workers_count; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                while(received < count)
+                {
+                    // half of the workers consume in batches
+                    if(i % 2 == 0)
+                    {
+                        received += static_cast<int>(
+                            dp.consume_bulk<int>(workers[i], std::back_inserter(results[i]), 8, true, 10));
+                    }
+                    else if(auto result = dp.consume<int>(workers[i], true, 10))
+                    {
+                        results[i].push_back(result.value());
+                        ++received;
+                    }
+                }
+            });
+        }
+
+        std::thread producer([&dp]()
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                while(dp.produce(queue_1, i) != data_pit_result::success)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        producer.join();
+        for(auto &t : threads)
+        {
+            t.join();
+        }
+
+        // every data has been consumed exactly once
+        ASSERT_EQ(count, received);
+        std::vector<int> all;
+        for(auto& result : results)
+        {
+            all.insert(all.end(), result.begin(), result.end());
+        }
+        std::sort(all.begin(), all.end());
+        for(auto i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(i, all[i]);
+        }
+    }
+}
+
+TEST(data_pit, test_handles)
+{
+    data_pit dp;
+    ASSERT_FALSE(dp.consumer_handle(1).has_value());
+
+    auto consumer = dp.consumer_handle(dp.register_consumer(queue_1)).value();
+    auto producer = dp.producer_handle(queue_1);
+    ASSERT_EQ(queue_1, producer.queue_id());
+
+    // the handles produce and consume as the calls taking ids do
+    ASSERT_EQ(data_pit_result::success, producer.produce(1));
+    std::string text = "two";
+    ASSERT_EQ(data_pit_result::type_mismatch, producer.produce(text));
+    ASSERT_EQ(data_pit_result::success, producer.emplace<int>(2));
+    std::vector<int> batch{3, 4};
+    ASSERT_EQ(data_pit_result::success, producer.produce_bulk<int>(batch));
+    ASSERT_EQ(1, consumer.consume<int>().value());
+    ASSERT_EQ(2, *consumer.consume_view<int>().value());
+    std::vector<int> result;
+    ASSERT_EQ(2, consumer.consume_bulk<int>(std::back_inserter(result), 10));
+    ASSERT_EQ((std::vector<int>{3, 4}), result);
+    ASSERT_FALSE(consumer.consume<int>().has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, consumer.get_last_error());
+    ASSERT_FALSE(consumer.consume<std::string>().has_value());
+    ASSERT_EQ(data_pit_result::type_mismatch, consumer.get_last_error());
+
+    // the data produced through the ids reach the handles too
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 5));
+    ASSERT_EQ(5, consumer.consume_move<int>().value());
+
+    // a handle to an unregistered consumer consumes nothing, even if its id is reused
+    dp.unregister_consumer(consumer.consumer_id());
+    auto other = dp.register_consumer(queue_1);
+    ASSERT_EQ(consumer.consumer_id(), other);
+    ASSERT_EQ(data_pit_result::success, producer.produce(6));
+    ASSERT_FALSE(consumer.consume<int>().has_value());
+    ASSERT_EQ(data_pit_result::consumer_not_found, consumer.get_last_error());
+    ASSERT_EQ(6, dp.consume<int>(other).value());
+}
+
+TEST(data_pit, test_handles_single_producer)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer, 16));
+    auto consumer = dp.consumer_handle(dp.register_consumer(queue_1)).value();
+    auto producer = dp.producer_handle(queue_1);
+
+    const int count = 10000;
+    std::thread producer_thread([&producer]()
+    {
+        for(auto i = 0; i < count;)
+        {
+            if(producer.produce(i) == data_pit_result::success) ++i;
+        }
+    });
+    for(auto i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(i, consumer.consume<int>(true, 1000).value());
+    }
+    producer_thread.join();
+}
+
+// A memory resource counting the allocations it forwards to another one
+struct counting_resource : std::pmr::memory_resource
+{
+    explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        ++allocations;
+        return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        upstream->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* upstream;
+    std::atomic<int> allocations = 0;
+};
+
+TEST(data_pit, test_memory_resource)
+{
+    // the pool takes its memory from the heap at startup only
+    counting_resource heap;
+    std::pmr::synchronized_pool_resource pool(&heap);
+    counting_resource queues(&pool);
+    data_pit dp(&queues);
+    dp.set_queue_size(queue_1, 16);
+    auto consumer = dp.register_consumer(queue_1);
+
+    const std::pmr::string payload(100, 'x');
+    auto round = [&]()
+    {
+        for(auto i = 0; i < 10; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, payload));
+        }
+        for(auto i = 0; i < 10; ++i)
+        {
+            auto view = dp.consume_view<std::pmr::string>(consumer);
+            ASSERT_EQ(payload, **view);
+        }
+    };
+    for(auto i = 0; i < 10; ++i)
+    {
+        round();
+    }
+
+    // in steady state, the slots and the payloads come from the pool without touching the heap
+    auto heap_allocations = heap.allocations.load();
+    auto queue_allocations = queues.allocations.load();
+    for(auto i = 0; i < 1000; ++i)
+    {
+        round();
+    }
+    ASSERT_EQ(heap_allocations, heap.allocations.load());
+    ASSERT_EQ(queue_allocations + 10000, queues.allocations.load());
+
+    // a queue can take its storage from a resource of its own
+    counting_resource own;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_2, data_pit_queue_mode::single_producer, 16, &own));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_2, 42));
+    ASSERT_EQ(1, own.allocations.load());
+    ASSERT_EQ(queue_allocations + 10000, queues.allocations.load());
+}
+
+TEST(data_pit, test_overflow_policies)
+{
+    data_pit dp;
+    dp.set_queue_size(queue_1, 4);
+    auto consumer = dp.register_consumer(queue_1);
+
+    // overwrite_oldest drops the oldest data, except the data viewed
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::overwrite_oldest));
+    for(auto i = 0; i < 10; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    ASSERT_EQ(6, dp.get_dropped_count(queue_1));
+
+    // asking for the drop count of a missing queue does not create it
+    ASSERT_EQ(0, dp.get_dropped_count(99));
+    ASSERT_FALSE(dp.get_queue_capacity(99).has_value());
+    {
+        auto view = dp.consume_view<int>(consumer);
+        ASSERT_EQ(6, **view);
+        ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 10));
+    }
+    for(auto i = 10; i < 13; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    ASSERT_EQ(8, dp.get_dropped_count(queue_1));
+    ASSERT_EQ(9, dp.consume<int>(consumer).value());
+    ASSERT_EQ(10, dp.consume<int>(consumer).value());
+
+    // drop_newest keeps the queue as it is
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::drop_newest));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 13));
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 14));
+    ASSERT_EQ(data_pit_result::data_dropped, dp.produce(queue_1, 15));
+    ASSERT_EQ(9, dp.get_dropped_count(queue_1));
+
+    // grow makes room for every data
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::grow));
+    for(auto i = 15; i < 100; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+    }
+    for(auto i = 11; i < 100; ++i)
+    {
+        ASSERT_EQ(i, dp.consume<int>(consumer).value());
+    }
+    ASSERT_EQ(9, dp.get_dropped_count(queue_1));
+
+    // reject leaves the retry to the producer
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::reject));
+    dp.set_queue_size(queue_1, 1);
+    ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 100));
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(queue_1, 101));
+    ASSERT_EQ(9, dp.get_dropped_count(queue_1));
+}
+
+TEST(data_pit, test_overflow_block)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, mode, 2));
+        ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::block, 10000));
+        auto consumer = dp.register_consumer(queue_1);
+
+        // the producer waits for the consumer instead of failing
+        const int count = 1000;
+        std::thread producer([&dp]()
+        {
+            for(auto i = 0; i < count; ++i)
+            {
+                ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, i));
+            }
+        });
+        for(auto i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(i, dp.consume<int>(consumer, true, 10000).value());
+        }
+        producer.join();
+        ASSERT_EQ(0, dp.get_dropped_count(queue_1));
+
+        // the wait ends once the timeout expires
+        ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::block, 20));
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 0));
+        ASSERT_EQ(data_pit_result::success, dp.produce(queue_1, 1));
+        auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(data_pit_result::timeout_expired, dp.produce(queue_1, 2));
+        ASSERT_LE(20, std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start).count());
+    }
+
+    // the data of a single_producer queue can be neither dropped nor moved
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(queue_1, data_pit_queue_mode::single_producer));
+    ASSERT_EQ(data_pit_result::policy_not_supported,
+              dp.set_overflow_policy(queue_1, data_pit_overflow_policy::overwrite_oldest));
+    ASSERT_EQ(data_pit_result::policy_not_supported, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::grow));
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(queue_1, data_pit_overflow_policy::drop_newest));
+}
+
+TEST(data_pit, test_poll)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(0, data_pit_queue_mode::single_producer, 16));
+    std::vector<unsigned int> consumers;
+    for(auto queue = 0; queue < 50; ++queue)
+    {
+        consumers.push_back(dp.register_consumer(queue));
+    }
+
+    // nothing is ready yet
+    std::vector<unsigned int> ready;
+    ASSERT_EQ(0, dp.poll(consumers, std::back_inserter(ready), 0));
+    ASSERT_EQ(0, dp.poll(consumers, std::back_inserter(ready), 10));
+    ASSERT_TRUE(ready.empty());
+
+    // a single wait returns the consumers with data available, whatever their queue
+    for(auto queue : {0, 7})
+    {
+        std::thread producer([&dp, queue]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ASSERT_EQ(data_pit_result::success, dp.produce(queue, queue));
+        });
+        ready.clear();
+        ASSERT_EQ(1, dp.poll(consumers, std::back_inserter(ready), 10000));
+        ASSERT_EQ(consumers[queue], ready[0]);
+        ASSERT_EQ(queue, dp.consume<int>(ready[0]).value());
+        producer.join();
+    }
+
+    ASSERT_EQ(data_pit_result::success, dp.produce(3, 3));
+    ASSERT_EQ(data_pit_result::success, dp.produce(42, 42));
+    ready.clear();
+    ASSERT_EQ(2, dp.poll(consumers, std::back_inserter(ready), 10000));
+    ASSERT_EQ((std::vector<unsigned int>{consumers[3], consumers[42]}), ready);
+
+    // unknown consumers are ignored
+    std::vector<unsigned int> unknown{1000};
+    ASSERT_EQ(0, dp.poll(unknown, std::back_inserter(ready), 0));
+}
+
+// A coroutine which starts right away and destroys itself once done
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// An executor queueing the coroutines, which are resumed when the test runs them
+struct queued_executor
+{
+    std::vector<std::coroutine_handle<>>* handles;
+
+    void operator()(std::coroutine_handle<> handle) const { handles->push_back(handle); }
+
+    static void run(std::vector<std::coroutine_handle<>>& handles)
+    {
+        auto queued = std::move(handles);
+        handles.clear();
+        for(auto handle : queued) handle.resume();
+    }
+};
+
+detached_task consume_async(data_pit& dp, unsigned int consumer_id, queued_executor executor,
+                            std::vector<std::optional<int>>& results, int count)
+{
+    for(auto i = 0; i < count; ++i)
+    {
+        results.push_back(co_await dp.async_consume<int>(consumer_id, executor));
+    }
+}
+
+detached_task consume_bulk_async(data_pit& dp, unsigned int consumer_id, std::vector<int>& results)
+{
+    results = co_await dp.async_consume_bulk<int>(consumer_id, 10);
+}
+
+// A coroutine which starts right away and is kept until its handle is destroyed
+struct owned_task
+{
+    struct promise_type
+    {
+        owned_task get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+owned_task consume_owned(data_pit& dp, unsigned int consumer_id, std::vector<std::optional<int>>& results)
+{
+    results.push_back(co_await dp.async_consume<int>(consumer_id));
+}
+
+TEST(data_pit, test_async_consume)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(0, mode, 16));
+        auto consumer_id = dp.register_consumer(0);
+        std::vector<std::coroutine_handle<>> handles;
+        std::vector<std::optional<int>> results;
+
+        // data already available are consumed without suspending
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 1));
+        consume_async(dp, consumer_id, {&handles}, results, 3);
+        ASSERT_EQ(1, results.size());
+        ASSERT_EQ(1, results[0].value());
+
+        // the coroutine is suspended until the data are produced, then resumed on the executor
+        ASSERT_TRUE(handles.empty());
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 2));
+        ASSERT_EQ(1, handles.size());
+        ASSERT_EQ(1, results.size());
+        queued_executor::run(handles);
+        ASSERT_EQ(2, results.size());
+        ASSERT_EQ(2, results[1].value());
+
+        // unregistering the consumer resumes the coroutine without data
+        dp.unregister_consumer(consumer_id);
+        ASSERT_EQ(1, handles.size());
+        queued_executor::run(handles);
+        ASSERT_EQ(3, results.size());
+        ASSERT_FALSE(results[2].has_value());
+
+        // an unknown consumer gets no data
+        results.clear();
+        consume_async(dp, 1000, {&handles}, results, 1);
+        ASSERT_EQ(1, results.size());
+        ASSERT_FALSE(results[0].has_value());
+
+        // a coroutine destroyed while suspended is never resumed, whatever its place among the waiters
+        results.clear();
+        auto other_id = dp.register_consumer(0);
+        ASSERT_EQ(data_pit_result::success, dp.seek_to_latest(other_id));
+        std::vector<owned_task> tasks;
+        for(auto i = 0; i < 3; ++i)
+        {
+            tasks.push_back(consume_owned(dp, other_id, results));
+        }
+        tasks[1].handle.destroy();
+        tasks[2].handle.destroy();
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 4));
+        ASSERT_EQ(1, results.size());
+        ASSERT_EQ(4, results[0].value());
+        ASSERT_TRUE(tasks[0].handle.done());
+        tasks[0].handle.destroy();
+    }
+}
+
+TEST(data_pit, test_async_consume_bulk)
+{
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(0, data_pit_queue_mode::multi_producer, 16));
+    auto consumer_id = dp.register_consumer(0);
+
+    // the inline executor resumes the coroutine on the producer thread
+    std::vector<int> results;
+    consume_bulk_async(dp, consumer_id, results);
+    std::thread producer([&dp]()
+    {
+        std::vector<int> data{1, 2, 3};
+        ASSERT_EQ(data_pit_result::success, dp.produce_bulk<int>(0, data));
+    });
+    producer.join();
+    ASSERT_EQ((std::vector<int>{1, 2, 3}), results);
+}
+
+#if defined(__linux__)
+// Check if a file descriptor is readable, without waiting
+bool fd_readable(int fd)
+{
+    pollfd descriptor{fd, POLLIN, 0};
+    return ::poll(&descriptor, 1, 0) == 1 && (descriptor.revents & POLLIN);
+}
+
+TEST(data_pit, test_consumer_fd)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(0, mode, 16));
+        auto consumer_1 = dp.register_consumer(0);
+        auto consumer_2 = dp.register_consumer(0);
+        ASSERT_FALSE(dp.consumer_fd(1000).has_value());
+        ASSERT_EQ(data_pit_result::consumer_not_found, dp.rearm_consumer_fd(1000));
+
+        // the descriptor is readable once data are produced, and only for the consumers with data available
+        auto fd_1 = dp.consumer_fd(consumer_1).value();
+        auto fd_2 = dp.consumer_fd(consumer_2).value();
+        ASSERT_EQ(fd_1, dp.consumer_fd(consumer_1).value());
+        ASSERT_FALSE(fd_readable(fd_1));
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 1));
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 2));
+        ASSERT_TRUE(fd_readable(fd_1));
+        ASSERT_TRUE(fd_readable(fd_2));
+
+        // rearming keeps the descriptor readable while data are left
+        ASSERT_EQ(data_pit_result::success, dp.rearm_consumer_fd(consumer_1));
+        ASSERT_TRUE(fd_readable(fd_1));
+        ASSERT_EQ(1, dp.consume<int>(consumer_1).value());
+        ASSERT_EQ(2, dp.consume<int>(consumer_1).value());
+        ASSERT_EQ(data_pit_result::success, dp.rearm_consumer_fd(consumer_1));
+        ASSERT_FALSE(fd_readable(fd_1));
+        ASSERT_TRUE(fd_readable(fd_2));
+
+        // a producer on another thread wakes up a thread waiting on the descriptor
+        std::thread producer([&dp]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, 3));
+        });
+        pollfd descriptor{fd_1, POLLIN, 0};
+        ASSERT_EQ(1, ::poll(&descriptor, 1, 10000));
+        ASSERT_EQ(3, dp.consume<int>(consumer_1).value());
+        producer.join();
+
+        // resetting a consumer makes its data available again
+        ASSERT_EQ(data_pit_result::success, dp.rearm_consumer_fd(consumer_1));
+        ASSERT_FALSE(fd_readable(fd_1));
+        dp.reset_consumer(consumer_1);
+        ASSERT_TRUE(fd_readable(fd_1));
+
+        dp.unregister_consumer(consumer_1);
+        ASSERT_FALSE(dp.consumer_fd(consumer_1).has_value());
+    }
+}
+
+TEST(data_pit, test_shared_queue)
+{
+    auto name = "/data_pit_test_shared_queue_" + std::to_string(getpid());
+    data_pit::remove_shared_queue(name);
+
+    data_pit dp;
+    ASSERT_EQ(data_pit_result::success,
+              dp.attach_shared_queue<int64_t>(0, name, data_pit_queue_mode::single_producer, 16));
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(0, data_pit_overflow_policy::block, 10000));
+    ASSERT_EQ(data_pit_result::policy_not_supported, dp.set_overflow_policy(0, data_pit_overflow_policy::grow));
+    ASSERT_EQ(0, dp.register_consumer(0, 1));
+
+    // the other process attaches to the queue by name, and consumes what this one produces
+    const int messages = 1000;
+    auto child = fork();
+    ASSERT_NE(-1, child);
+    if(child == 0)
+    {
+        data_pit other;
+        if(other.attach_shared_queue<int64_t>(3, name) != data_pit_result::success) _exit(1);
+        if(other.attach_shared_queue<int32_t>(4, name) != data_pit_result::type_mismatch) _exit(2);
+        auto consumer_id = other.register_consumer(3);
+        for(int64_t i = 0; i < messages; ++i)
+        {
+            auto data = other.consume<int64_t>(consumer_id, true, 10000);
+            if(!data.has_value() || data.value() != i) _exit(3);
+        }
+        _exit(0);
+    }
+
+    // the producer waits for the consumer of the other process to free slots
+    for(int64_t i = 0; i < messages; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+    }
+    int status = 0;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    // the consumer of the stopped process no longer retains data
+    auto consumer_id = dp.register_consumer(0);
+    std::vector<int64_t> data;
+    dp.consume_bulk<int64_t>(consumer_id, std::back_inserter(data), 16);
+    ASSERT_EQ(messages - 1, data.back());
+    ASSERT_EQ(data_pit_result::success, dp.set_overflow_policy(0, data_pit_overflow_policy::reject));
+    for(int64_t i = 0; i < 16; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+    }
+    ASSERT_TRUE(data_pit::remove_shared_queue(name));
+
+    // an object whose creator stopped before publishing its header is created again with the same size, and an
+    // object that cannot be created is removed
+    auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(0, ftruncate(fd, mapped_ring::header_size + 16 * sizeof(int64_t)));
+    close(fd);
+    ASSERT_EQ(data_pit_result::storage_error, data_pit().attach_shared_queue<int64_t>(0, name,
+              data_pit_queue_mode::single_producer, 32));
+    {
+        data_pit recovered;
+        ASSERT_EQ(data_pit_result::success, recovered.attach_shared_queue<int64_t>(0, name,
+                  data_pit_queue_mode::single_producer, 16));
+        ASSERT_EQ(data_pit_result::success, recovered.produce(0, int64_t(1)));
+    }
+    ASSERT_TRUE(data_pit::remove_shared_queue(name));
+    ASSERT_EQ(data_pit_result::storage_error, data_pit().attach_shared_queue<int64_t>(0, name,
+              data_pit_queue_mode::single_producer, size_t(1) << 50));
+    ASSERT_FALSE(data_pit::remove_shared_queue(name));
+}
+#endif
+
+TEST(data_pit, test_consumer_lag)
+{
+    data_pit dp;
+    auto consumer_1 = dp.register_consumer(0);
+    auto consumer_2 = dp.register_consumer(0);
+    ASSERT_FALSE(dp.get_consumer_lag(1000).has_value());
+    ASSERT_EQ(0, dp.get_consumer_lag(consumer_1).value());
+
+    for(auto i = 0; i < 5; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+    }
+    ASSERT_EQ(0, dp.consume<int>(consumer_1).value());
+    ASSERT_EQ(4, dp.get_consumer_lag(consumer_1).value());
+    ASSERT_EQ(5, dp.get_consumer_lag(consumer_2).value());
+
+    // the cleared data are no longer counted
+    dp.clear_queue(0);
+    ASSERT_EQ(0, dp.get_consumer_lag(consumer_2).value());
+}
+
+#if DATA_PIT_STATS
+TEST(data_pit, test_queue_stats)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        ASSERT_FALSE(dp.get_queue_stats(0).has_value());
+        ASSERT_EQ(data_pit_result::success, dp.create_queue(0, mode, 4));
+        auto consumer_1 = dp.register_consumer(0);
+        auto consumer_2 = dp.register_consumer(0);
+
+        // the failed calls are counted by cause
+        for(auto i = 0; i < 4; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(0, 4));
+        ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(0, 1.0));
+        ASSERT_FALSE(dp.consume<double>(consumer_1).has_value());
+        auto stats = dp.get_queue_stats(0).value();
+        ASSERT_EQ(4, stats.produced);
+        ASSERT_EQ(4, stats.depth);
+        ASSERT_EQ(1, stats.full);
+        ASSERT_EQ(2, stats.type_mismatches);
+
+        // every consumer counts the data it consumes, and every blocking consume is counted in a latency bucket
+        std::vector<int> data;
+        ASSERT_EQ(4, dp.consume_bulk<int>(consumer_1, std::back_inserter(data), 10));
+        ASSERT_EQ(4, dp.consume_bulk<int>(consumer_2, std::back_inserter(data), 10, true, 10));
+        ASSERT_FALSE(dp.consume<int>(consumer_2, true, 10).has_value());
+        stats = dp.get_queue_stats(0).value();
+        ASSERT_EQ(8, stats.consumed);
+        ASSERT_EQ(1, stats.timeouts);
+        uint64_t waits = 0;
+        for(auto count : stats.wait_latency) waits += count;
+        ASSERT_EQ(2, waits);
+        ASSERT_EQ(stats.lock_contentions == 0, stats.lock_wait_ns == 0);
+    }
+}
+#endif
+
+TEST(data_pit, test_persistent_queue)
+{
+    struct tick
+    {
+        int64_t time;
+        double price;
+    };
+    auto path = (std::filesystem::temp_directory_path() / "data_pit_test_persistent_queue").string();
+    std::filesystem::remove(path);
+
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        {
+            data_pit dp;
+            ASSERT_EQ(data_pit_result::success, dp.create_persistent_queue<tick>(0, path, mode, 8));
+            ASSERT_EQ(data_pit_result::queue_already_exists, dp.create_persistent_queue<tick>(0, path, mode, 8));
+            ASSERT_EQ(0, dp.register_persistent_consumer(1, 7));
+            auto reader = dp.register_persistent_consumer(0, 7);
+            ASSERT_NE(0, reader);
+            ASSERT_EQ(0, dp.register_persistent_consumer(0, 7));
+            ASSERT_EQ(data_pit_result::type_mismatch, dp.produce(0, 1));
+
+            for(auto i = 0; i < 5; ++i)
+            {
+                ASSERT_EQ(data_pit_result::success, dp.produce(0, tick{i, i * 0.5}));
+            }
+            ASSERT_EQ(0, dp.consume<tick>(reader).value().time);
+            ASSERT_EQ(1, dp.consume<tick>(reader).value().time);
+            ASSERT_EQ(data_pit_result::success, dp.sync_queue(0));
+        }
+
+        // the queue and its consumers resume where they were left
+        {
+            data_pit dp;
+            ASSERT_EQ(data_pit_result::type_mismatch, dp.create_persistent_queue<int64_t>(0, path, mode, 8));
+            ASSERT_EQ(data_pit_result::success, dp.create_persistent_queue<tick>(0, path, mode, 64));
+            auto reader = dp.register_persistent_consumer(0, 7);
+            auto late = dp.register_persistent_consumer(0, 8);
+            ASSERT_EQ(2, dp.consume<tick>(reader).value().time);
+            ASSERT_EQ(1.5, dp.consume<tick>(reader).value().price);
+            ASSERT_EQ(0, dp.consume<tick>(late).value().time);
+
+            // the capacity of the file is kept, and the data of the slowest consumer are retained
+            for(auto i = 5; i < 9; ++i)
+            {
+                ASSERT_EQ(data_pit_result::success, dp.produce(0, tick{i, 0}));
+            }
+            ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(0, tick{9, 0}));
+
+            // an unregistered consumer forgets its position and no longer retains data
+            dp.unregister_consumer(late);
+            dp.unregister_consumer(reader);
+        }
+
+        {
+            data_pit dp;
+            ASSERT_EQ(data_pit_result::success, dp.create_persistent_queue<tick>(0, path, mode));
+            auto reader = dp.register_persistent_consumer(0, 7);
+            ASSERT_EQ(1, dp.consume<tick>(reader).value().time);
+            dp.clear_queue(0);
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, tick{9, 0}));
+        }
+
+        // the cleared data stay cleared
+        {
+            data_pit dp;
+            ASSERT_EQ(data_pit_result::success, dp.create_persistent_queue<tick>(0, path, mode));
+            auto reader = dp.register_persistent_consumer(0, 7);
+            ASSERT_EQ(9, dp.consume<tick>(reader).value().time);
+            ASSERT_FALSE(dp.consume<tick>(reader).has_value());
+        }
+        std::filesystem::remove(path);
+    }
+
+    ASSERT_EQ(data_pit_result::storage_error,
+              data_pit().create_persistent_queue<int>(0, "/nonexistent/data_pit_test_persistent_queue"));
+
+    // a file holding something else than a ring is left untouched, and a ring too large for memory is refused
+    {
+        std::ofstream file(path);
+        file << "not a ring";
+    }
+    ASSERT_EQ(data_pit_result::storage_error, data_pit().create_persistent_queue<tick>(0, path));
+    ASSERT_EQ(10, std::filesystem::file_size(path));
+    std::filesystem::remove(path);
+
+    // a ring whose creation was interrupted before its header was published is created again, unless its size differs
+    {
+        std::ofstream file(path);
+    }
+    std::filesystem::resize_file(path, mapped_ring::header_size + 8 * sizeof(tick) + 1);
+    ASSERT_EQ(data_pit_result::storage_error, data_pit().create_persistent_queue<tick>(
+        0, path, data_pit_queue_mode::multi_producer, 8));
+    std::filesystem::resize_file(path, mapped_ring::header_size + 8 * sizeof(tick));
+    {
+        data_pit dp;
+        ASSERT_EQ(data_pit_result::success,
+                  dp.create_persistent_queue<tick>(0, path, data_pit_queue_mode::multi_producer, 8));
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, tick{1, 1.0}));
+    }
+    ASSERT_EQ(data_pit_result::success, data_pit().create_persistent_queue<tick>(0, path));
+    std::filesystem::remove(path);
+    ASSERT_EQ(data_pit_result::storage_error, data_pit().create_persistent_queue<tick>(
+        0, path, data_pit_queue_mode::multi_producer, std::numeric_limits<size_t>::max() / 8));
+    std::filesystem::remove(path);
+}
+
+TEST(data_pit, test_seek)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        dp.create_queue(0, mode, 16);
+        auto consumer_id = dp.register_consumer(0);
+        auto worker_id = dp.register_consumer(0, 1);
+        for(auto i = 0; i < 10; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_EQ(std::make_pair(uint64_t(0), uint64_t(10)), dp.get_queue_offsets(0).value());
+        ASSERT_FALSE(dp.get_queue_offsets(1).has_value());
+
+        // seeking forward skips the data, and seeking backward replays them
+        ASSERT_EQ(data_pit_result::success, dp.seek(consumer_id, 7));
+        ASSERT_EQ(7, dp.get_consumer_offset(consumer_id).value());
+        ASSERT_EQ(3, dp.get_consumer_lag(consumer_id).value());
+        ASSERT_EQ(7, dp.consume<int>(consumer_id).value());
+        ASSERT_EQ(data_pit_result::success, dp.seek(consumer_id, 2));
+        ASSERT_EQ(2, dp.consume<int>(consumer_id).value());
+        ASSERT_EQ(data_pit_result::offset_out_of_range, dp.seek(consumer_id, 11));
+        ASSERT_EQ(3, dp.get_consumer_offset(consumer_id).value());
+        ASSERT_EQ(data_pit_result::consumer_not_found, dp.seek(0, 0));
+        ASSERT_FALSE(dp.get_consumer_offset(0).has_value());
+
+        // seeking a consumer of a group moves the group
+        ASSERT_EQ(data_pit_result::success, dp.seek_to_latest(worker_id));
+        ASSERT_FALSE(dp.consume<int>(worker_id).has_value());
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 10));
+        ASSERT_EQ(10, dp.consume<int>(worker_id).value());
+
+        // the consumer sought past the data no longer retains them
+        ASSERT_EQ(data_pit_result::success, dp.seek_to_latest(consumer_id));
+        ASSERT_FALSE(dp.consume<int>(consumer_id).has_value());
+        for(auto i = 11; i < 27; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_EQ(data_pit_result::offset_out_of_range, dp.seek(consumer_id, 2));
+        ASSERT_EQ(11, dp.consume<int>(consumer_id).value());
+    }
+}
+
+TEST(data_pit, test_retention)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        dp.create_queue(0, mode, 8);
+
+        // a queue without consumers keeps its newest data, instead of filling up with stale ones
+        ASSERT_EQ(data_pit_result::success, dp.set_retention(0, 3));
+        for(auto i = 0; i < 20; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_EQ(std::make_pair(uint64_t(17), uint64_t(20)), dp.get_queue_offsets(0).value());
+
+        // a late joiner starts from the oldest data retained, and cannot seek before them
+        auto consumer_id = dp.register_consumer(0);
+        ASSERT_EQ(17, dp.consume<int>(consumer_id).value());
+        ASSERT_EQ(data_pit_result::offset_out_of_range, dp.seek(consumer_id, 16));
+        ASSERT_EQ(data_pit_result::success, dp.seek(consumer_id, 17));
+
+        // the data are still retained for the consumers which have not read them
+        for(auto i = 20; i < 25; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(0, 25));
+        ASSERT_EQ(17, dp.consume<int>(consumer_id).value());
+
+        // a retention of no data makes the consumers start at the latest data
+        ASSERT_EQ(data_pit_result::success, dp.set_retention(0, 0));
+        auto latest_id = dp.register_consumer(0);
+        ASSERT_FALSE(dp.consume<int>(latest_id).has_value());
+        dp.reset_consumer(consumer_id);
+        ASSERT_FALSE(dp.consume<int>(consumer_id).has_value());
+
+        // the data older than the age retained are skipped
+        ASSERT_EQ(data_pit_result::success,
+                  dp.set_retention(0, std::numeric_limits<size_t>::max(), 50));
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 30));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 31));
+        auto recent_id = dp.register_consumer(0);
+        ASSERT_EQ(31, dp.consume<int>(recent_id).value());
+        ASSERT_EQ(30, dp.consume<int>(latest_id).value());
+
+        // the data moved out by a consumer are copied while retained, so that the consumers yet to come replay them
+        data_pit move_dp;
+        move_dp.create_queue(1, mode, 8);
+        ASSERT_EQ(data_pit_result::success, move_dp.set_retention(1, 2));
+        auto mover_id = move_dp.register_consumer(1);
+        for(auto i = 0; i < 5; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, move_dp.produce(1, std::to_string(i)));
+        }
+        for(auto i = 0; i < 5; ++i)
+        {
+            ASSERT_EQ(std::to_string(i), move_dp.consume_move<std::string>(mover_id).value());
+        }
+        auto replay_id = move_dp.register_consumer(1);
+        ASSERT_EQ("3", move_dp.consume<std::string>(replay_id).value());
+        ASSERT_EQ("4", move_dp.consume<std::string>(replay_id).value());
+        ASSERT_FALSE(move_dp.consume<std::string>(replay_id).has_value());
+        ASSERT_EQ(std::make_pair(uint64_t(3), uint64_t(5)), move_dp.get_queue_offsets(1).value());
+    }
+}
+
+TEST(data_pit, test_filtered_consumer)
+{
+    struct order
+    {
+        int symbol;
+        double price;
+    };
+
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        dp.create_queue(0, mode, 100);
+        auto tens = dp.register_consumer<int>(0, [](int value) { return value % 10 == 0; });
+        auto all = dp.register_consumer(0);
+
+        // the data are spread over the end and the start of the slots, in more than one block of the filter
+        for(auto i = 0; i < 60; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        std::vector<int> data;
+        ASSERT_EQ(60, dp.consume_bulk<int>(all, std::back_inserter(data), 60));
+        ASSERT_EQ(0, dp.consume<int>(tens).value());
+        ASSERT_EQ(10, dp.consume<int>(tens).value());
+        data.clear();
+        ASSERT_EQ(4, dp.consume_bulk<int>(tens, std::back_inserter(data), 100));
+        ASSERT_EQ((std::vector<int>{20, 30, 40, 50}), data);
+        for(auto i = 60; i < 160; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+            ASSERT_EQ(i, dp.consume<int>(all).value());
+        }
+        data.clear();
+        ASSERT_EQ(3, dp.consume_bulk<int>(tens, std::back_inserter(data), 3));
+        ASSERT_EQ((std::vector<int>{60, 70, 80}), data);
+
+        ASSERT_EQ(90, dp.consume_move<int>(tens).value());
+        ASSERT_EQ(100, **dp.consume_view<int>(tens));
+        ASSERT_EQ(5, dp.consume_bulk<int>(tens, std::back_inserter(data), 100));
+
+        // the data skipped are not retained, and a blocking consumer waits for data matching
+        dp.unregister_consumer(all);
+        for(auto i = 0; i < 100; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, 201));
+        }
+        ASSERT_FALSE(dp.consume<int>(tens).has_value());
+        ASSERT_EQ(data_pit_result::no_data_available, dp.get_last_error(tens));
+        std::thread producer([&dp]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            for(auto i = 202; i <= 210; ++i)
+            {
+                dp.produce(0, i);
+            }
+        });
+        ASSERT_EQ(210, dp.consume<int>(tens, true, 10000).value());
+        producer.join();
+        ASSERT_FALSE(dp.consume<int>(tens, true, 10).has_value());
+        ASSERT_EQ(data_pit_result::timeout_expired, dp.get_last_error(tens));
+    }
+
+    // a consumer can match the keys of the data in a set
+    data_pit dp;
+    auto watched = dp.register_consumer<order>(0, [](const order& o) { return o.symbol; },
+                                               std::unordered_set<int>{3, 5});
+    auto mismatched = dp.register_consumer<int>(0, [](int) { return true; });
+    for(auto i = 0; i < 8; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, order{i, i * 1.5}));
+    }
+    ASSERT_EQ(3, dp.consume<order>(watched)->symbol);
+    ASSERT_EQ(7.5, dp.consume<order>(watched)->price);
+    ASSERT_FALSE(dp.consume<order>(watched).has_value());
+    ASSERT_FALSE(dp.consume<order>(mismatched).has_value());
+    ASSERT_EQ(data_pit_result::type_mismatch, dp.get_last_error(mismatched));
+}
+
+// Whether data of type T can be produced in the queue 0 of a data_pit_static
+template<typename Pit, typename T>
+concept produces_to_first_queue = requires(Pit& pit, T data) { pit.template produce<0>(data); };
+
+TEST(data_pit, test_static)
+{
+    struct tick
+    {
+        int64_t time;
+        double price;
+    };
+    typedef data_pit_static<data_pit_queue<0, tick>,
+                            data_pit_queue<1, std::string, data_pit_queue_mode::single_producer, 4>> topology;
+
+    // the type of the data is checked at compile time
+    static_assert(std::is_same_v<topology::data_type<1>, std::string>);
+    static_assert(produces_to_first_queue<topology, tick>);
+    static_assert(!produces_to_first_queue<topology, std::string>);
+
+    topology dp;
+    auto ticks = dp.register_consumer<0>().value();
+    auto names = dp.register_consumer<1>().value();
+    auto late = dp.register_consumer<0>([](const tick& t) { return t.time > 1; }).value();
+    ASSERT_EQ(data_pit_result::success, dp.produce<0>(tick{1, 1.5}));
+    ASSERT_EQ(data_pit_result::success, dp.emplace<0>(tick{2, 2.5}));
+    std::vector<std::string> batch{"a", "b", "c", "d"};
+    ASSERT_EQ(data_pit_result::success, dp.produce_bulk<1>(batch));
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce<1>("e"));
+
+    ASSERT_EQ(1, ticks.consume()->time);
+    ASSERT_EQ(2.5, ticks.consume_move()->price);
+    ASSERT_FALSE(ticks.consume().has_value());
+    ASSERT_EQ(data_pit_result::no_data_available, ticks.get_last_error());
+    ASSERT_EQ(2, late.consume()->time);
+    ASSERT_EQ("a", **names.consume_view());
+    std::vector<std::string> data;
+    ASSERT_EQ(3, names.consume_bulk(std::back_inserter(data), 10));
+    ASSERT_EQ((std::vector<std::string>{"b", "c", "d"}), data);
+
+    // the queues are the queues of the data_pit, which manages the consumers
+    ASSERT_EQ(0, dp.pit().get_consumer_lag(ticks.consumer_id()).value());
+    dp.pit().reset_consumer(ticks.consumer_id());
+    ASSERT_EQ(1, ticks.consume()->time);
+    ASSERT_FALSE(dp.pit().channel<int>(1).has_value());
+    dp.unregister_consumer(ticks);
+    ASSERT_FALSE(ticks.consume().has_value());
+    ASSERT_EQ(data_pit_result::consumer_not_found, ticks.get_last_error());
+}
+
+TEST(data_pit, test_queue_options)
+{
+    // the capacity is rounded up to a power of two, also when the queue is resized
+    data_pit dp;
+    data_pit_queue_options options;
+    options.power_of_two = true;
+    ASSERT_EQ(data_pit_result::success, dp.create_queue(0, options));
+    ASSERT_EQ(1024, dp.get_queue_capacity(0).value());
+    for(auto i = 0; i < 1024; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, dp.produce(0, 1024));
+    dp.set_queue_size(0, 2000);
+    ASSERT_EQ(2048, dp.get_queue_capacity(0).value());
+    auto consumer_id = dp.register_consumer(0);
+    for(auto i = 0; i < 1024; ++i)
+    {
+        ASSERT_EQ(i, dp.consume<int>(consumer_id).value());
+    }
+    ASSERT_EQ(data_pit_result::queue_already_exists, dp.create_queue(0, options));
+
+    // a typed queue allocates its prefaulted slots up front, and never takes another type
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit typed_dp;
+        data_pit_queue_options typed_options;
+        typed_options.mode = mode;
+        typed_options.capacity = 100;
+        typed_options.power_of_two = true;
+        typed_options.prefault = true;
+        typed_options.numa_node = 0;
+        ASSERT_EQ(data_pit_result::success, typed_dp.create_queue<std::string>(1, typed_options));
+        ASSERT_EQ(128, typed_dp.get_queue_capacity(1).value());
+        ASSERT_EQ(data_pit_result::type_mismatch, typed_dp.produce(1, 5));
+        auto typed_id = typed_dp.register_consumer(1);
+        for(auto round = 0; round < 3; ++round)
+        {
+            for(auto i = 0; i < 128; ++i)
+            {
+                ASSERT_EQ(data_pit_result::success, typed_dp.produce(1, std::to_string(i)));
+            }
+            for(auto i = 0; i < 128; ++i)
+            {
+                ASSERT_EQ(std::to_string(i), typed_dp.consume<std::string>(typed_id).value());
+            }
+        }
+    }
+
+    // the queues used before being created take the options of the data_pit
+    data_pit_queue_options defaults;
+    defaults.capacity = 5;
+    data_pit defaults_dp(defaults);
+    for(auto i = 0; i < 5; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, defaults_dp.produce(2, i));
+    }
+    ASSERT_EQ(data_pit_result::queue_is_full, defaults_dp.produce(2, 5));
+    ASSERT_FALSE(defaults_dp.get_queue_capacity(3).has_value());
+}
+
+TEST(data_pit, test_snapshot)
+{
+    for(auto mode : {data_pit_queue_mode::multi_producer, data_pit_queue_mode::single_producer})
+    {
+        data_pit dp;
+        dp.create_queue(0, mode, 100);
+        auto consumer_id = dp.register_consumer(0);
+
+        // the snapshot covers the data still in the queue, which wrap around the end of the slots
+        for(auto i = 0; i < 100; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        for(auto i = 0; i < 60; ++i)
+        {
+            ASSERT_EQ(i, dp.consume<int>(consumer_id).value());
+        }
+        for(auto i = 100; i < 150; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+        }
+        ASSERT_FALSE(dp.snapshot<float>(0).has_value());
+        auto snapshot = dp.snapshot<int>(0).value();
+        ASSERT_EQ(dp.get_queue_offsets(0)->first, snapshot.begin_offset());
+        ASSERT_EQ(150, snapshot.end_offset());
+        auto blocks = snapshot.blocks();
+        ASSERT_FALSE(blocks[1].empty());
+        ASSERT_EQ(snapshot.size(), blocks[0].size() + blocks[1].size());
+        ASSERT_EQ(149, blocks[1].back());
+        ASSERT_EQ(snapshot.begin_offset(), uint64_t(snapshot[0]));
+
+        // the data are reduced on a number of threads
+        auto expected = 0;
+        for(auto i = snapshot.begin_offset(); i < snapshot.end_offset(); ++i)
+        {
+            expected += int(i);
+        }
+        ASSERT_EQ(expected, snapshot.transform_reduce(0, std::plus<>(), [](int data) { return data; }, 4, 7));
+
+        // the pinned data are retained even once consumed, so the queue stays full until the snapshot is released
+        for(auto i = 60; i < 150; ++i)
+        {
+            ASSERT_EQ(i, dp.consume<int>(consumer_id).value());
+        }
+        auto room = 0;
+        while(dp.produce(0, 150 + room) == data_pit_result::success) ++room;
+        ASSERT_EQ(100 - int(snapshot.size()), room);
+        ASSERT_EQ(149, snapshot[snapshot.size() - 1]);
+        snapshot.release();
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, 150 + room));
+    }
+
+    // the producers keep appending while the snapshot is visited
+    data_pit dp;
+    dp.create_queue(0, data_pit_queue_mode::single_producer, 40000);
+    for(auto i = 0; i < 10000; ++i)
+    {
+        ASSERT_EQ(data_pit_result::success, dp.produce(0, i));
+    }
+    std::thread producer([&dp]
+    {
+        for(auto i = 10000; i < 30000; ++i)
+        {
+            dp.produce(0, i);
+        }
+    });
+    std::atomic<int64_t> sum{0};
+    std::atomic<int> count{0};
+    ASSERT_EQ(data_pit_result::success, dp.for_each_parallel<int>(0, [&](int data)
+    {
+        sum.fetch_add(data, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+    }, 4));
+    producer.join();
+    ASSERT_GE(count.load(), 10000);
+    ASSERT_EQ(int64_t(count.load()) * (count.load() - 1) / 2, sum.load());
+    ASSERT_EQ(data_pit_result::no_data_available, dp.for_each_parallel<int>(1, [](int) {}));
+}
+
+#if defined(__linux__)
+TEST(data_pit, test_bridge)
+{
+    // connect two sockets over the loopback interface
+    auto listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, listener);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    ASSERT_EQ(0, bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    ASSERT_EQ(0, listen(listener, 1));
+    ASSERT_EQ(0, getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length));
+    auto sending = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, connect(sending, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    auto receiving = accept(listener, nullptr, nullptr);
+    ASSERT_NE(-1, receiving);
+
+    data_pit local;
+    data_pit remote;
+    auto local_consumer = local.register_consumer(0);
+    auto remote_consumer_1 = remote.register_consumer(1);
+    auto remote_consumer_2 = remote.register_consumer(1);
+    const int messages = 1000;
+    {
+        // the sender tails the local queue next to its other consumers
+        data_pit_bridge_sender<std::string> sender(local, 0, sending, 64);
+        data_pit_bridge_receiver<std::string> receiver(remote, 1, receiving);
+        ASSERT_NE(0, sender.consumer_id());
+        ASSERT_EQ(0, sender.forward());
+        ASSERT_EQ(data_pit_result::no_data_available, sender.get_last_error());
+        ASSERT_EQ(0, receiver.receive(0));
+        ASSERT_EQ(data_pit_result::timeout_expired, receiver.get_last_error());
+
+        std::jthread forwarder([&sender](std::stop_token token) { sender.run(token, 10); });
+        for(auto i = 0; i < messages; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, local.produce(0, std::to_string(i)));
+        }
+        size_t received = 0;
+        while(received < messages)
+        {
+            auto count = receiver.receive(10000);
+            ASSERT_EQ(data_pit_result::success, receiver.get_last_error());
+            received += count;
+        }
+        ASSERT_EQ(messages, received);
+    }
+
+    // the data are produced once into the remote queue, and every remote consumer gets them
+    for(auto i = 0; i < messages; ++i)
+    {
+        ASSERT_EQ(std::to_string(i), local.consume<std::string>(local_consumer).value());
+        ASSERT_EQ(std::to_string(i), remote.consume<std::string>(remote_consumer_1).value());
+        ASSERT_EQ(std::to_string(i), remote.consume<std::string>(remote_consumer_2).value());
+    }
+    ASSERT_FALSE(remote.consume<std::string>(remote_consumer_1).has_value());
+
+    // a remote queue smaller than the stream holds the data back until it has room, in parts no larger than itself
+    {
+        data_pit source;
+        data_pit small;
+        small.create_queue(2, data_pit_queue_mode::multi_producer, 10);
+        auto small_consumer = small.register_consumer(2);
+        data_pit_bridge_sender<std::string> sender(source, 0, sending, 256);
+        data_pit_bridge_receiver<std::string> receiver(small, 2, receiving);
+        for(auto i = 0; i < 25; ++i)
+        {
+            ASSERT_EQ(data_pit_result::success, source.produce(0, std::to_string(i)));
+        }
+        ASSERT_EQ(25, sender.forward());
+        ASSERT_EQ(10, receiver.receive(10000));
+        ASSERT_EQ(15, receiver.pending());
+        ASSERT_EQ(0, receiver.receive(0));
+        ASSERT_EQ(data_pit_result::queue_is_full, receiver.get_last_error());
+        for(auto i = 0; i < 10; ++i)
+        {
+            ASSERT_EQ(std::to_string(i), small.consume<std::string>(small_consumer).value());
+        }
+        ASSERT_EQ(10, receiver.receive(0));
+        ASSERT_EQ(5, receiver.pending());
+        for(auto i = 10; i < 20; ++i)
+        {
+            ASSERT_EQ(std::to_string(i), small.consume<std::string>(small_consumer).value());
+        }
+        ASSERT_EQ(5, receiver.receive(0));
+        ASSERT_EQ(0, receiver.pending());
+        ASSERT_EQ(data_pit_result::success, receiver.get_last_error());
+
+        // no data are lost while the remote consumer is slower than the stream
+        std::jthread forwarder([&sender](std::stop_token token) { sender.run(token, 10); });
+        std::jthread receiver_thread([&receiver](std::stop_token token) { receiver.run(token, 10); });
+        for(auto i = 25; i < 2025; ++i)
+        {
+            while(source.produce(0, std::to_string(i)) != data_pit_result::success) std::this_thread::yield();
+        }
+        for(auto i = 20; i < 2025; ++i)
+        {
+            ASSERT_EQ(std::to_string(i), small.consume<std::string>(small_consumer, true, 10000).value());
+        }
+    }
+
+    // a batch beyond the limits of the receiver shuts the connection down before anything is allocated
+    {
+        data_pit_bridge_frame frame;
+        frame.count = 1;
+        frame.bytes = uint64_t(1) << 40;
+        ASSERT_EQ(ssize_t(sizeof(frame)), send(sending, &frame, sizeof(frame), 0));
+        data_pit_bridge_receiver<std::string> receiver(remote, 1, receiving);
+        ASSERT_EQ(0, receiver.receive(1000));
+        ASSERT_EQ(data_pit_result::connection_error, receiver.get_last_error());
+        char byte;
+        ASSERT_EQ(0, recv(sending, &byte, 1, 0));
+    }
+
+    // the receiver reports the connection closed by the other end
+    close(sending);
+    data_pit_bridge_receiver<std::string> receiver(remote, 1, receiving);
+    ASSERT_EQ(0, receiver.receive(1000));
+    ASSERT_EQ(data_pit_result::connection_error, receiver.get_last_error());
+    close(receiving);
+    close(listener);
+}
+#endif
+
+TEST(concurrent_hash_map, test_sharded)
+{
+    concurrent_hash_map<int, int, 8> map;
+    std::list<std::thread> threads;
+    for(auto i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&map, i]()
+        {
+            for(auto key = i * 1000; key < (i + 1) * 1000; ++key)
+            {
+                map[key] = key * 2;
+                map.find_or_insert(-key - 1, [key](int& value) { value = key; });
+            }
+        });
+    }
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+
+    ASSERT_EQ(8000, map.keys().size());
+    ASSERT_EQ(84, map.find(42).value());
+    ASSERT_EQ(41, map.at(-42));
+    ASSERT_TRUE(map.erase(42));
+    ASSERT_FALSE(map.erase(42));
+    ASSERT_FALSE(map.contains(42));
+    ASSERT_FALSE(map.find(42).has_value());
+
+    map.clear();
+    ASSERT_TRUE(map.keys().empty());
+}
+
+TEST(flat_hash_map, test_insert_find_erase)
+{
+    flat_hash_map<int, std::string> map;
+    ASSERT_TRUE(map.empty());
+    ASSERT_TRUE(map.find(1) == map.end());
+    ASSERT_THROW(map.at(1), std::out_of_range);
+
+    const int count = 50000;
+    for(auto i = 0; i < count; ++i)
+    {
+        ASSERT_TRUE(map.try_emplace(i, std::to_string(i)).second);
+    }
+    ASSERT_FALSE(map.try_emplace(42, "other").second);
+    ASSERT_EQ(count, map.size());
+
+    // erase half of the entries, then insert them again over the deleted slots
+    for(auto i = 0; i < count; i += 2)
+    {
+        ASSERT_EQ(1, map.erase(i));
+    }
+    ASSERT_EQ(0, map.erase(0));
+    ASSERT_EQ(count / 2, map.size());
+    for(auto round = 0; round < 4; ++round)
+    {
+        for(auto i = 0; i < count; i += 2)
+        {
+            map[i] = std::to_string(i);
+        }
+        for(auto i = 0; i < count; i += 2)
+        {
+            map.erase(i);
+        }
+    }
+    for(auto i = 0; i < count; ++i)
+    {
+        auto it = map.find(i);
+        ASSERT_EQ(i % 2 == 1, it != map.end());
+        if(it != map.end())
+        {
+            ASSERT_EQ(std::to_string(i), it->second);
+        }
+    }
+
+    // the iteration visits every entry once
+    long long sum = 0;
+    for(const auto& [key, value] : map)
+    {
+        sum += key;
+    }
+    ASSERT_EQ(static_cast<long long>(count / 2) * (count / 2), sum);
+
+    map.clear();
+    ASSERT_TRUE(map.empty());
+    ASSERT_TRUE(map.begin() == map.end());
+}
+
+TEST(flat_hash_map, test_concurrent_backend)
+{
+    concurrent_hash_map<int, std::shared_ptr<int>, 4, flat_hash_map<int, std::shared_ptr<int>>> map;
+    std::list<std::thread> threads;
+    for(auto i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&map, i]()
+        {
+            for(auto key = i * 1000; key < (i + 1) * 1000; ++key)
+            {
+                ASSERT_TRUE(map.insert_or_assign(key, std::make_shared<int>(key)));
+                ASSERT_EQ(key, *map.find(key).value());
+            }
+        });
+    }
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+    ASSERT_FALSE(map.insert_or_assign(1, std::make_shared<int>(-1)));
+    ASSERT_EQ(-1, *map.find(1).value());
+    ASSERT_EQ(4000, map.keys().size());
+}
+
+TEST(rcu_hash_map, test_readers_and_writers)
+{
+    rcu_hash_map<int, std::string> map;
+    auto& stable = map.find_or_insert(-1, [](std::string& value) { value = "stable"; });
+
+    // readers look the keys up while writers insert and erase them
+    std::atomic<bool> done{false};
+    std::list<std::thread> readers;
+    for(auto i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&map, &done]()
+        {
+            while(!done.load())
+            {
+                for(auto key = 0; key < 100; ++key)
+                {
+                    auto value = map.find(key);
+                    if(value.has_value())
+                    {
+                        ASSERT_EQ(std::to_string(key), value.value());
+                    }
+                }
+                ASSERT_EQ("stable", map.at(-1));
+            }
+        });
+    }
+    std::list<std::thread> writers;
+    for(auto i = 0; i < 2; ++i)
+    {
+        writers.emplace_back([&map, i]()
+        {
+            for(auto key = i * 50; key < (i + 1) * 50; ++key)
+            {
+                ASSERT_TRUE(map.insert_or_assign(key, std::to_string(key)));
+                if(key % 2 == 0)
+                {
+                    ASSERT_TRUE(map.erase(key));
+                }
+            }
+        });
+    }
+    for(auto &t : writers)
+    {
+        t.join();
+    }
+    done = true;
+    for(auto &t : readers)
+    {
+        t.join();
+    }
+
+    // the reference taken before the writes is still valid
+    ASSERT_EQ("stable", stable);
+    ASSERT_EQ(51, map.keys().size());
+    ASSERT_FALSE(map.contains(42));
+    ASSERT_EQ("43", map.find(43).value());
+    ASSERT_FALSE(map.insert_or_assign(43, "other"));
+    ASSERT_EQ("other", map[43]);
+    ASSERT_THROW(map.at(42), std::out_of_range);
+
+    map.clear();
+    ASSERT_TRUE(map.keys().empty());
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);